@@ -7,7 +7,14 @@
 #include <glm/gtc/matrix_transform.hpp>
 
 #include <learnopengl/shader.h>
+#include <rg/GLState.h>
+#include <rg/Material.h>
+#include <rg/RenderQueue.h>
+#include <rg/VertexPacking.h>
 
+#include <algorithm>
+#include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 using namespace std;
@@ -25,115 +32,318 @@ struct Vertex {
     glm::vec3 Bitangent;
 };
 
-
-
-struct Texture {
-    unsigned int id;
-    string type;
-    string path;
+// geometry already in the layout it is drawn with, e.g. mapped from a mesh cache
+struct MeshGeometry {
+    const void* vertices = nullptr;     // vertexCount * layout.stride bytes
+    size_t vertexCount = 0;
+    VertexLayout layout;
+    glm::mat4 positionTransform = glm::mat4(1.0f);
+    VertexPackingReport packingReport;
+    const void* indices = nullptr;      // indexCount elements of indexType
+    GLenum indexType = GL_UNSIGNED_INT;
+    size_t indexCount = 0;
+    glm::vec3 boundsMin = glm::vec3(0.0f);
+    glm::vec3 boundsMax = glm::vec3(0.0f);
+    glm::vec3 boundsCenter = glm::vec3(0.0f);
+    float boundsRadius = 0.0f;
 };
 
+
 class Mesh {
 public:
     // mesh Data
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
-    vector<Texture>      textures;
+    // textures and parameters, shared with the other meshes of the model that use the same ones
+    shared_ptr<Material> material;
 
-    unsigned int VAO;
-    std::string glslIdentifierPrefix;
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    unsigned int VAO = 0;
+    unsigned int VertexCount = 0;
+    unsigned int IndexCount = 0;
+    // GL_UNSIGNED_SHORT when every vertex can be addressed with 16 bits
+    GLenum IndexType = GL_UNSIGNED_INT;
+    // where the mesh starts in the buffers bound to VAO, not 0 once it shares its model's buffers
+    int BaseVertex = 0;
+    unsigned int FirstIndex = 0;
+    // local space bounds, computed when the mesh is created
+    glm::vec3 BoundsMin;
+    glm::vec3 BoundsMax;
+    glm::vec3 BoundsCenter;
+    float BoundsRadius;
+    // how the vertices are stored on the GPU, see VertexPacking.h
+    VertexLayout Layout;
+    VertexPackingReport PackingReport;
+    // maps the stored positions to local space, not identity when they are quantized
+    glm::mat4 PositionTransform = glm::mat4(1.0f);
+    // constructor, pass the arrays with std::move to keep a single copy
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, shared_ptr<Material> material, const VertexPackingOptions &packing = VertexPackingOptions())
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->material = std::move(material);
 
+        computeBounds();
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        if(FitsShortIndices(this->vertices.size()))
+        {
+            IndexType = GL_UNSIGNED_SHORT;
+            vector<unsigned short> shortIndices(this->indices.begin(), this->indices.end());
+            setupMesh(this->vertices.data(), this->vertices.size(), shortIndices.data(), this->indices.size(), packing);
+        }
+        else
+            setupMesh(this->vertices.data(), this->vertices.size(), this->indices.data(), this->indices.size(), packing);
     }
 
-    // render the mesh
-    void Draw(Shader &shader)
+    // constructor for geometry that is already processed, e.g. mapped from a mesh cache. The arrays
+    // go to the GPU as they are and are not kept on the CPU, vertices and indices stay empty.
+    Mesh(const MeshGeometry &geometry, shared_ptr<Material> material)
+        : material(std::move(material)), IndexType(geometry.indexType), BoundsMin(geometry.boundsMin), BoundsMax(geometry.boundsMax),
+          BoundsCenter(geometry.boundsCenter), BoundsRadius(geometry.boundsRadius), Layout(geometry.layout),
+          PackingReport(geometry.packingReport), PositionTransform(geometry.positionTransform)
+    {
+        upload(geometry.vertices, geometry.vertexCount, geometry.indices, geometry.indexCount);
+    }
+
+    // owns its VAO and buffers, so it can be moved but not copied
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    Mesh(Mesh &&other) noexcept
+    {
+        moveFrom(other);
+    }
+
+    Mesh& operator=(Mesh &&other) noexcept
+    {
+        if(this != &other)
+        {
+            release();
+            moveFrom(other);
+        }
+        return *this;
+    }
+
+    ~Mesh()
     {
-        // bind appropriate textures
-        unsigned int diffuseNr  = 1;
-        unsigned int specularNr = 1;
-        unsigned int normalNr   = 1;
-        unsigned int heightNr   = 1;
-        for(unsigned int i = 0; i < textures.size(); i++)
+        release();
+    }
+
+    // frees the CPU copy of the geometry once it is uploaded, the GPU buffers stay
+    void ReleaseGeometry()
+    {
+        vector<Vertex>().swap(vertices);
+        vector<unsigned int>().swap(indices);
+    }
+
+    // bytes held by vertices and indices
+    size_t GeometryBytes() const
+    {
+        return vertices.capacity() * sizeof(Vertex) + indices.capacity() * sizeof(unsigned int);
+    }
+
+    static bool FitsShortIndices(size_t vertexCount) { return vertexCount <= 65536; }
+    static size_t IndexSize(GLenum indexType) { return indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int); }
+
+    // the mesh's own buffers, 0 once it shares its model's buffers
+    unsigned int VertexBuffer() const { return VBO; }
+    unsigned int IndexBuffer() const { return EBO; }
+
+    // Switches to a VAO over buffers the mesh's data was copied into, at the given offsets, and
+    // deletes the mesh's own buffers. The new VAO needs the same Layout and IndexType.
+    void ShareBuffers(unsigned int vao, int baseVertex, unsigned int firstIndex)
+    {
+        release();
+        VAO = vao;
+        ownsVertexArray = false;
+        BaseVertex = baseVertex;
+        FirstIndex = firstIndex;
+    }
+
+    // sets the attribute pointers of a layout on the bound VAO and GL_ARRAY_BUFFER
+    static void EnableAttributes(const VertexLayout &layout)
+    {
+        GLsizei stride = (GLsizei) layout.stride;
+        if(!layout.packed)
+        {
+            // vertex Positions
+            glEnableVertexAttribArray(0);
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+            // vertex normals
+            glEnableVertexAttribArray(1);
+            glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Normal));
+            // vertex texture coords
+            glEnableVertexAttribArray(2);
+            glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, TexCoords));
+            // vertex tangent
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Tangent));
+            // vertex bitangent
+            glEnableVertexAttribArray(4);
+            glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, stride, (void*)offsetof(Vertex, Bitangent));
+            return;
+        }
+        glEnableVertexAttribArray(0);
+        if(layout.quantizedPositions)
+            glVertexAttribPointer(0, 3, GL_SHORT, GL_FALSE, stride, (void*)0);
+        else
+            glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_SHORT, GL_FALSE, stride, (void*)(size_t)layout.normalOffset);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, layout.halfTexCoords ? GL_HALF_FLOAT : GL_FLOAT, GL_FALSE, stride, (void*)(size_t)layout.texCoordOffset);
+        // bitangents are rebuilt in the shader from the sign next to the tangent, attribute 4 stays unused
+        if(layout.tangents)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
-            // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
-            if(name == "texture_diffuse")
-                number = std::to_string(diffuseNr++);
-            else if(name == "texture_specular")
-                number = std::to_string(specularNr++); // transfer unsigned int to stream
-            else if(name == "texture_normal")
-                number = std::to_string(normalNr++); // transfer unsigned int to stream
-            else if(name == "texture_height")
-                number = std::to_string(heightNr++); // transfer unsigned int to stream
-
-            // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (glslIdentifierPrefix + name + number).c_str()), i);
-            // and finally bind the texture
-            glBindTexture(GL_TEXTURE_2D, textures[i].id);
+            glEnableVertexAttribArray(3);
+            glVertexAttribPointer(3, 4, GL_SHORT, GL_FALSE, stride, (void*)(size_t)layout.tangentOffset);
         }
+    }
 
+    // render the mesh, the caller's model matrix has to include PositionTransform
+    void Draw(Shader &shader)
+    {
+        // bind the textures and set the samplers and parameters, the names were resolved before
+        if(material)
+            material->Bind(shader);
 
+        // draw mesh, the VAO stays bound until something else needs one
+        GLState::Get().BindVertexArray(VAO);
+        glDrawElementsBaseVertex(GL_TRIANGLES, IndexCount, IndexType, (void*)(FirstIndex * IndexSize(IndexType)), BaseVertex);
+    }
 
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
+    // queue the mesh instead of drawing it, the queue binds the material like Draw does.
+    // Nothing is queued when the bounds are outside the frustum.
+    void Submit(RenderQueue &queue, RenderPass pass, Shader &shader, const glm::mat4 &model, int modelLocation)
+    {
+        if(!queue.IsVisible(model, BoundsMin, BoundsMax, BoundsCenter, BoundsRadius, IndexCount / 3))
+            return;
 
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
+        DrawItem item;
+        item.shader = &shader;
+        item.model = model * PositionTransform;
+        item.modelLocation = modelLocation;
+        item.vao = VAO;
+        item.command = DRAW_ELEMENTS;
+        item.first = (int) FirstIndex;
+        item.count = (int) IndexCount;
+        item.indexType = IndexType;
+        item.baseVertex = BaseVertex;
+        item.material = material.get();
+        queue.Submit(pass, std::move(item));
     }
 
 private:
     // render data
-    unsigned int VBO, EBO;
+    unsigned int VBO = 0, EBO = 0;
+    // false once VAO belongs to the model the mesh shares buffers with
+    bool ownsVertexArray = true;
+
+    void release()
+    {
+        if(ownsVertexArray && VAO != 0)
+            glDeleteVertexArrays(1, &VAO);
+        if(VBO != 0)
+            glDeleteBuffers(1, &VBO);
+        if(EBO != 0)
+            glDeleteBuffers(1, &EBO);
+        VAO = VBO = EBO = 0;
+    }
+
+    // takes over everything, other keeps no GL objects
+    void moveFrom(Mesh &other)
+    {
+        vertices = std::move(other.vertices);
+        indices = std::move(other.indices);
+        material = std::move(other.material);
+        VAO = other.VAO;
+        VertexCount = other.VertexCount;
+        IndexCount = other.IndexCount;
+        IndexType = other.IndexType;
+        BaseVertex = other.BaseVertex;
+        FirstIndex = other.FirstIndex;
+        BoundsMin = other.BoundsMin;
+        BoundsMax = other.BoundsMax;
+        BoundsCenter = other.BoundsCenter;
+        BoundsRadius = other.BoundsRadius;
+        Layout = other.Layout;
+        PackingReport = other.PackingReport;
+        PositionTransform = other.PositionTransform;
+        VBO = other.VBO;
+        EBO = other.EBO;
+        ownsVertexArray = other.ownsVertexArray;
+        other.VAO = other.VBO = other.EBO = 0;
+    }
+
+    // AABB of the vertices, and a sphere around the AABB center reaching the furthest vertex
+    void computeBounds()
+    {
+        BoundsMin = glm::vec3(0.0f);
+        BoundsMax = glm::vec3(0.0f);
+        BoundsCenter = glm::vec3(0.0f);
+        BoundsRadius = 0.0f;
+        if(vertices.empty())
+            return;
+
+        BoundsMin = BoundsMax = vertices[0].Position;
+        for(const Vertex& vertex : vertices)
+        {
+            BoundsMin = glm::min(BoundsMin, vertex.Position);
+            BoundsMax = glm::max(BoundsMax, vertex.Position);
+        }
+        BoundsCenter = 0.5f * (BoundsMin + BoundsMax);
+        for(const Vertex& vertex : vertices)
+            BoundsRadius = glm::max(BoundsRadius, glm::length(vertex.Position - BoundsCenter));
+    }
 
-    // initializes all the buffer objects/arrays
-    void setupMesh()
+    // lays the vertices out as packing asks and uploads them, the indices are IndexType elements
+    void setupMesh(const Vertex* vertexData, size_t vertexCount, const void* indexData, size_t indexCount, const VertexPackingOptions &packing)
     {
+        if(packing.enabled)
+        {
+            setupPacked(vertexData, vertexCount, indexData, indexCount, packing);
+            return;
+        }
+        // A great thing about structs is that their memory layout is sequential for all its items.
+        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
+        // again translates to 3/2 floats which translates to a byte array.
+        Layout.stride = sizeof(Vertex);
+        PackingReport.bytes = PackingReport.unpackedBytes = vertexCount * sizeof(Vertex);
+        upload(vertexData, vertexCount, indexData, indexCount);
+    }
+
+    // initializes all the buffer objects/arrays, the vertices are in Layout and the indices IndexType elements
+    void upload(const void* vertexData, size_t vertexCount, const void* indexData, size_t indexCount)
+    {
+        VertexCount = (unsigned int) vertexCount;
+        IndexCount = (unsigned int) indexCount;
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
         glGenBuffers(1, &VBO);
         glGenBuffers(1, &EBO);
 
-        glBindVertexArray(VAO);
+        GLState::Get().BindVertexArray(VAO);
         // load data into vertex buffers
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
-        // A great thing about structs is that their memory layout is sequential for all its items.
-        // The effect is that we can simply pass a pointer to the struct and it translates perfectly to a glm::vec3/2 array which
-        // again translates to 3/2 floats which translates to a byte array.
-        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), &vertices[0], GL_STATIC_DRAW);
-
+        glBufferData(GL_ARRAY_BUFFER, vertexCount * Layout.stride, vertexData, GL_STATIC_DRAW);
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), &indices[0], GL_STATIC_DRAW);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexCount * IndexSize(IndexType), indexData, GL_STATIC_DRAW);
 
         // set the vertex attribute pointers
-        // vertex Positions
-        glEnableVertexAttribArray(0);
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-        // vertex normals
-        glEnableVertexAttribArray(1);
-        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
-        // vertex texture coords
-        glEnableVertexAttribArray(2);
-        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
-        // vertex tangent
-        glEnableVertexAttribArray(3);
-        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Tangent));
-        // vertex bitangent
-        glEnableVertexAttribArray(4);
-        glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Bitangent));
-
-        glBindVertexArray(0);
+        EnableAttributes(Layout);
+        GLState::Get().BindVertexArray(0);
+    }
+
+    // packed layout, needs a vertex shader that decodes octahedral normals (mainShaderPacked.vs)
+    void setupPacked(const Vertex* vertexData, size_t vertexCount, const void* indexData, size_t indexCount, const VertexPackingOptions &packing)
+    {
+        PackedVertices packed = PackVertices(vertexData, vertexCount, BoundsCenter, packing);
+        Layout = packed.layout;
+        PackingReport = packed.report;
+        PositionTransform = glm::scale(glm::translate(glm::mat4(1.0f), packed.positionOffset), glm::vec3(packed.positionScale));
+        // positions and uvs already fell back to floats, a normal this far off means a broken input
+        if(PackingReport.normalError > packing.normalTolerance || PackingReport.tangentError > packing.normalTolerance)
+            std::cout << "Mesh: octahedral normals off by " << std::max(PackingReport.normalError, PackingReport.tangentError) << std::endl;
+        upload(packed.data.data(), vertexCount, indexData, indexCount);
     }
 };
 #endif
\ No newline at end of file
@@ -12,16 +12,26 @@
 
 #include <learnopengl/mesh.h>
 #include <learnopengl/shader.h>
-
+#include <rg/CpuProfiler.h>
+#include <rg/MeshCache.h>
+#include <rg/MeshOptimizer.h>
+#include <rg/ObjLoader.h>
+#include <rg/ProcessMemory.h>
+#include <rg/ResourceManager.h>
+#include <rg/TextureStreamer.h>
+
+#include <algorithm>
 #include <string>
+#include <chrono>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <unordered_map>
 #include <vector>
 using namespace std;
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false, TextureStreamer *streamer = nullptr);
 
 
 
@@ -29,17 +39,93 @@ class Model
 {
 public:
     // model data
-    vector<Texture> textures_loaded;	// stores all the textures loaded so far, optimization to make sure textures aren't loaded more than once.
+    vector<Texture> textures_loaded;	// stores all the textures the model uses, each once
     vector<Mesh>    meshes;
+    // one per distinct set of textures and parameters, the meshes using it share the object
+    vector<shared_ptr<Material>> materials;
     string directory;
     bool gammaCorrection;
-
-    // constructor, expects a filepath to a 3D model.
-    Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
+    // how the model was loaded, for comparing cold and warm starts
+    bool LoadedFromCache = false;
+    bool LoadedNatively = false;
+    double LoadMs = 0.0;
+    // what MeshOptimizer did to the imported meshes, empty when they came from the cache
+    MeshOptimizationReport Optimization;
+    // meshes before the ones sharing a material were merged (when MergeMeshes), and the VAOs the meshes are drawn from
+    unsigned int ImportedMeshes = 0;
+    unsigned int VertexArrays = 0;
+    // process memory around loadModel, the peak is the highest resident size during the load
+    ProcessMemory MemoryBeforeLoad;
+    ProcessMemory MemoryAfterLoad;
+
+    static const unsigned int ImportFlags = aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace;
+    // part of the mesh cache key, the native OBJ loader merges vertices Assimp keeps apart
+    static const unsigned int NativeObjFlag = 1u << 31;
+    // part of the mesh cache key, cached meshes are stored after MeshOptimizer ran
+    static const unsigned int OptimizedFlag = 1u << 30;
+    // part of the mesh cache key, set when the cached meshes are merged by material
+    static const unsigned int MergedFlag = 1u << 29;
+
+    // vertex layout of every mesh, packed meshes need mainShaderPacked.vs
+    VertexPackingOptions Packing;
+    // concatenate the parts that share a material, one draw per material instead of one per part
+    // but the parts are no longer culled on their own
+    bool MergeMeshes;
+
+    // constructor, expects a filepath to a 3D model. .obj files are read by ObjLoader, on the job
+    // system's threads when one is given, and fall back to Assimp if it fails. With a streamer the
+    // textures show a placeholder until they are decoded and uploaded.
+    Model(string const &path, bool gamma = false, JobSystem *jobs = nullptr, TextureStreamer *streamer = nullptr,
+          const VertexPackingOptions &packing = VertexPackingOptions(), bool mergeMeshes = false)
+        : gammaCorrection(gamma), Packing(packing), MergeMeshes(mergeMeshes), jobs(jobs), streamer(streamer)
     {
         loadModel(path);
     }
 
+    // owns its meshes and the buffers they share, so it can be moved but not copied
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+    Model(Model&&) = default;
+    Model& operator=(Model&&) = default;
+
+    // The model loaded from the same file with the same options while it is still alive, otherwise a
+    // new one. A copy of the file under another path is loaded again, its mtllib and textures
+    // resolve in its own directory. A model is shared by every handle to it, so
+    // SetShaderTextureNamePrefix and ReleaseGeometry apply to all of them.
+    static ResourceHandle<Model> Load(string const &path, bool gamma = false, JobSystem *jobs = nullptr, TextureStreamer *streamer = nullptr,
+                                      const VertexPackingOptions &packing = VertexPackingOptions(), bool mergeMeshes = false)
+    {
+        // the job system and the streamer only change how the model is loaded, not what is loaded
+        char variant[128];
+        std::snprintf(variant, sizeof(variant), "%d %d %d %g %g %g %d", gamma, packing.enabled, packing.tangents,
+                      packing.positionTolerance, packing.normalTolerance, packing.texCoordTolerance, mergeMeshes);
+        return ResourceManager::Get().Models().Acquire({path}, variant, [&]() {
+            return std::make_shared<Model>(path, gamma, jobs, streamer, packing, mergeMeshes);
+        });
+    }
+
+    // a handle to one of the model's meshes, it keeps the whole model alive
+    static ResourceHandle<Mesh> MeshHandle(const ResourceHandle<Model> &model, size_t index)
+    {
+        return ResourceHandle<Mesh>(model, &model->meshes[index]);
+    }
+
+    // frees the CPU copy of every mesh once the model is loaded, the mesh cache is already written
+    void ReleaseGeometry()
+    {
+        for(Mesh& mesh : meshes)
+            mesh.ReleaseGeometry();
+    }
+
+    // bytes of vertices and indices still held on the CPU
+    size_t GeometryBytes() const
+    {
+        size_t bytes = 0;
+        for(const Mesh& mesh : meshes)
+            bytes += mesh.GeometryBytes();
+        return bytes;
+    }
+
     // draws the model, and thus all its meshes
     void Draw(Shader &shader)
     {
@@ -47,33 +133,196 @@ public:
             meshes[i].Draw(shader);
     }
 
+    // queues all its meshes with the same model matrix
+    void Submit(RenderQueue &queue, RenderPass pass, Shader &shader, const glm::mat4 &model, int modelLocation)
+    {
+        for(unsigned int i = 0; i < meshes.size(); i++)
+            meshes[i].Submit(queue, pass, shader, model, modelLocation);
+    }
+
+    // vertex data of all meshes and the largest packing errors among them
+    VertexPackingReport PackingReport() const
+    {
+        VertexPackingReport report;
+        for(const Mesh& mesh : meshes)
+            report.Merge(mesh.PackingReport);
+        return report;
+    }
+
     void SetShaderTextureNamePrefix(std::string prefix) {
-        for (Mesh& mesh: meshes) {
-            mesh.glslIdentifierPrefix = prefix;
+        for (shared_ptr<Material>& material: materials) {
+            material->SetPrefix(prefix);
         }
     }
+    static bool IsObj(string const &path)
+    {
+        string extension = path.substr(path.find_last_of('.') + 1);
+        for (char& c : extension)
+            c = (char) tolower(c);
+        return extension == "obj";
+    }
+
 private:
+    JobSystem *jobs;
+    TextureStreamer *streamer;
+    // material libraries an .obj references, the mesh cache is checked against them too
+    vector<string> materialLibraries;
+
+    // VAOs and buffers the meshes were copied into, deleted with the model
+    struct SharedGeometry {
+        vector<unsigned int> arrays;
+        vector<unsigned int> buffers;
+
+        SharedGeometry() = default;
+        SharedGeometry(const SharedGeometry&) = delete;
+        SharedGeometry& operator=(const SharedGeometry&) = delete;
+        SharedGeometry(SharedGeometry &&other) noexcept
+        {
+            arrays.swap(other.arrays);
+            buffers.swap(other.buffers);
+        }
+        SharedGeometry& operator=(SharedGeometry &&other) noexcept
+        {
+            if(this != &other)
+            {
+                release();
+                arrays.swap(other.arrays);
+                buffers.swap(other.buffers);
+            }
+            return *this;
+        }
+        ~SharedGeometry()
+        {
+            release();
+        }
+
+        void release()
+        {
+            if(!arrays.empty())
+                glDeleteVertexArrays((GLsizei) arrays.size(), arrays.data());
+            if(!buffers.empty())
+                glDeleteBuffers((GLsizei) buffers.size(), buffers.data());
+            arrays.clear();
+            buffers.clear();
+        }
+    };
+    SharedGeometry sharedGeometry;
+    // index into materials by materialKey
+    map<string, size_t> materialIndex;
+    // the textures the model holds, by the path its materials name them with
+    unordered_map<string, ResourceHandle<TextureResource>> textureHandles;
+
+    // an imported mesh before it is merged, optimized and uploaded
+    struct ImportedMesh {
+        vector<Vertex> vertices;
+        vector<unsigned int> indices;
+        vector<Texture> textures;
+        float shininess = DefaultShininess;
+    };
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const &path)
+    {
+        RG_PROFILE_FUNCTION();
+        ProcessMemory::ResetPeak();
+        MemoryBeforeLoad = ProcessMemory::Current();
+        auto start = std::chrono::steady_clock::now();
+        // retrieve the directory path of the filepath
+        directory = path.substr(0, path.find_last_of('/'));
+
+        // A cache made from the same file with the same flags skips the importer. An .obj the native
+        // loader rejected was cached from Assimp's meshes, without NativeObjFlag, so both keys are tried.
+        uint64_t hash = 0;
+        bool hashed = MeshCache::HashFile(path, hash);
+        const unsigned int assimpFlags = ImportFlags | OptimizedFlag | (MergeMeshes ? MergedFlag : 0u);
+        const unsigned int nativeFlags = assimpFlags | NativeObjFlag;
+        unsigned int cacheFlags = IsObj(path) ? nativeFlags : assimpFlags;
+        LoadedFromCache = hashed && (loadCache(MeshCache::PathFor(path), hash, cacheFlags)
+                                     || (IsObj(path) && loadCache(MeshCache::PathFor(path), hash, assimpFlags)));
+        LoadedNatively = !LoadedFromCache && IsObj(path) && loadObj(path);
+        if(!LoadedFromCache && !LoadedNatively)
+        {
+            cacheFlags = assimpFlags;
+            if(!loadAssimp(path))
+                return;
+        }
+        if(!LoadedFromCache && hashed && !MeshCache::Write(MeshCache::PathFor(path), hash, cacheFlags, Packing, materialLibraries, meshes))
+            cout << "Failed to write mesh cache " << MeshCache::PathFor(path) << endl;
+        if(LoadedFromCache)
+            ImportedMeshes = (unsigned int) meshes.size();
+        shareBuffers();
+        MemoryAfterLoad = ProcessMemory::Current();
+        LoadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    bool loadAssimp(string const &path)
     {
         // read file via ASSIMP
         Assimp::Importer importer;
-        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        const aiScene* scene;
+        {
+            RG_PROFILE_ZONE("Assimp::Importer::ReadFile");
+            scene = importer.ReadFile(path, ImportFlags);
+        }
         // check for errors
         if(!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) // if is Not Zero
         {
             cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << endl;
-            return;
+            return false;
         }
-        // retrieve the directory path of the filepath
-        directory = path.substr(0, path.find_last_of('/'));
 
         // process ASSIMP's root node recursively
-        processNode(scene->mRootNode, scene);
+        vector<ImportedMesh> imported;
+        processNode(scene->mRootNode, scene, imported);
+        createMeshes(imported);
+        return true;
+    }
+
+    // creates the meshes straight from the mapped cache, only the textures are loaded
+    bool loadCache(const string &cachePath, uint64_t hash, unsigned int flags)
+    {
+        MeshCache cache;
+        if(!cache.Open(cachePath, hash, flags, Packing))
+            return false;
+        meshes.reserve(cache.Meshes().size());
+        for(const CachedMesh& cached : cache.Meshes())
+        {
+            vector<Texture> textures;
+            for(const Texture& texture : cached.textures)
+                textures.push_back(loadMaterialTexture(texture.path.c_str(), texture.type));
+            meshes.emplace_back(cached.geometry, findMaterial(std::move(textures), cached.shininess));
+        }
+        return true;
+    }
+
+    bool loadObj(const string &path)
+    {
+        ObjLoader loader(jobs);
+        bool loaded = loader.Load(path);
+        // Assimp reads the same libraries when it takes over
+        materialLibraries = loader.Libraries();
+        if(!loaded)
+        {
+            cout << "ObjLoader: " << loader.Error() << ", falling back to Assimp" << endl;
+            return false;
+        }
+        vector<ImportedMesh> imported;
+        for(ObjMesh& mesh : loader.Meshes())
+        {
+            ImportedMesh part;
+            for(const Texture& texture : mesh.textures)
+                part.textures.push_back(loadMaterialTexture(texture.path.c_str(), texture.type));
+            part.vertices = std::move(mesh.vertices);
+            part.indices = std::move(mesh.indices);
+            part.shininess = mesh.shininess;
+            imported.push_back(std::move(part));
+        }
+        createMeshes(imported);
+        return true;
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
-    void processNode(aiNode *node, const aiScene *scene)
+    void processNode(aiNode *node, const aiScene *scene, vector<ImportedMesh> &imported)
     {
         // process each mesh located at the current node
         for(unsigned int i = 0; i < node->mNumMeshes; i++)
@@ -81,24 +330,26 @@ private:
             // the node object only contains indices to index the actual objects in the scene.
             // the scene contains all the data, node is just to keep stuff organized (like relations between nodes).
             aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-            meshes.push_back(processMesh(mesh, scene));
+            imported.push_back(processMesh(mesh, scene));
         }
         // after we've processed all of the meshes (if any) we then recursively process each of the children nodes
         for(unsigned int i = 0; i < node->mNumChildren; i++)
         {
-            processNode(node->mChildren[i], scene);
+            processNode(node->mChildren[i], scene, imported);
         }
 
     }
 
-    Mesh processMesh(aiMesh *mesh, const aiScene *scene)
+    ImportedMesh processMesh(aiMesh *mesh, const aiScene *scene)
     {
+        RG_PROFILE_FUNCTION();
         // data to fill
         vector<Vertex> vertices;
         vector<unsigned int> indices;
         vector<Texture> textures;
 
         // walk through each of the mesh's vertices
+        vertices.reserve(mesh->mNumVertices);
         for(unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
             Vertex vertex;
@@ -161,6 +412,10 @@ private:
         // normal: texture_normalN
         aiColor3D color(0.0f, 0.0f, 0.0f);
         material->Get(AI_MATKEY_COLOR_AMBIENT, color);
+        // specular exponent, formats without one keep the default
+        float shininess = DefaultShininess;
+        if(material->Get(AI_MATKEY_SHININESS, shininess) != aiReturn_SUCCESS || shininess <= 0.0f)
+            shininess = DefaultShininess;
 
 
         // 1. diffuse maps
@@ -178,8 +433,139 @@ private:
 
 
 
-        // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        // return the extracted mesh data, createMeshes uploads it
+        ImportedMesh imported;
+        imported.vertices = std::move(vertices);
+        imported.indices = std::move(indices);
+        imported.textures = std::move(textures);
+        imported.shininess = shininess;
+        return imported;
+    }
+
+    // the textures and parameters a mesh is drawn with, meshes with the same key share a material
+    static string materialKey(const vector<Texture> &textures, float shininess)
+    {
+        string key;
+        for(const Texture& texture : textures)
+            key += texture.type + '\n' + texture.path + '\n';
+        return key + std::to_string(shininess);
+    }
+
+    // the model's material with these textures and parameters, created the first time it is asked for
+    shared_ptr<Material> findMaterial(vector<Texture> textures, float shininess)
+    {
+        auto inserted = materialIndex.emplace(materialKey(textures, shininess), materials.size());
+        if(inserted.second)
+            materials.push_back(std::make_shared<Material>(std::move(textures), shininess));
+        return materials[inserted.first->second];
+    }
+
+    // With MergeMeshes concatenates the imported meshes that share a material, as long as the
+    // result still fits 16 bit indices, then optimizes and uploads them. The meshes are static and
+    // already in model space (node transforms are not applied), so merging needs no pre-transform.
+    // Culling becomes coarser, but each material costs one draw instead of one per part.
+    void createMeshes(vector<ImportedMesh> &imported)
+    {
+        RG_PROFILE_FUNCTION();
+        ImportedMeshes = (unsigned int) imported.size();
+        vector<ImportedMesh> merged;
+        // unmerged every part stays a mesh of its own, the loop below then has nothing to do
+        if(!MergeMeshes)
+            merged.swap(imported);
+        map<string, vector<size_t>> byMaterial;
+        for(ImportedMesh& part : imported)
+        {
+            vector<size_t>& candidates = byMaterial[materialKey(part.textures, part.shininess)];
+            ImportedMesh* target = nullptr;
+            for(size_t candidate : candidates)
+            {
+                if(Mesh::FitsShortIndices(merged[candidate].vertices.size() + part.vertices.size()))
+                {
+                    target = &merged[candidate];
+                    break;
+                }
+            }
+            if(!target)
+            {
+                candidates.push_back(merged.size());
+                merged.push_back(std::move(part));
+                continue;
+            }
+            unsigned int base = (unsigned int) target->vertices.size();
+            target->vertices.insert(target->vertices.end(), part.vertices.begin(), part.vertices.end());
+            for(unsigned int index : part.indices)
+                target->indices.push_back(base + index);
+        }
+        imported.clear();
+        meshes.reserve(merged.size());
+        for(ImportedMesh& mesh : merged)
+        {
+            Optimization.Merge(MeshOptimizer::Optimize(mesh.vertices, mesh.indices));
+            meshes.emplace_back(std::move(mesh.vertices), std::move(mesh.indices), findMaterial(std::move(mesh.textures), mesh.shininess), Packing);
+        }
+    }
+
+    // Copies the meshes into one vertex buffer, one index buffer and one VAO per layout and index
+    // type, usually one for the whole model, and points each mesh at its range. The meshes are
+    // ordered by material first, so the queue draws them back to back with base vertex draws and no
+    // VAO switch. Copying on the GPU also covers meshes that came from the cache without CPU arrays.
+    void shareBuffers()
+    {
+        RG_PROFILE_FUNCTION();
+        std::stable_sort(meshes.begin(), meshes.end(), [](const Mesh &a, const Mesh &b) {
+            return a.material->Id() < b.material->Id();
+        });
+        vector<bool> shared(meshes.size(), false);
+        for(size_t first = 0; first < meshes.size(); first++)
+        {
+            if(shared[first])
+                continue;
+            const VertexLayout layout = meshes[first].Layout;
+            const GLenum indexType = meshes[first].IndexType;
+            vector<size_t> group;
+            size_t vertexBytes = 0, indexBytes = 0;
+            for(size_t i = first; i < meshes.size(); i++)
+            {
+                if(shared[i] || meshes[i].Layout != layout || meshes[i].IndexType != indexType)
+                    continue;
+                shared[i] = true;
+                group.push_back(i);
+                vertexBytes += (size_t) meshes[i].VertexCount * layout.stride;
+                indexBytes += (size_t) meshes[i].IndexCount * Mesh::IndexSize(indexType);
+            }
+            VertexArrays++;
+            if(group.size() == 1)
+                continue;
+
+            unsigned int vao, buffers[2];
+            glGenVertexArrays(1, &vao);
+            glGenBuffers(2, buffers);
+            GLState::Get().BindVertexArray(vao);
+            glBindBuffer(GL_ARRAY_BUFFER, buffers[0]);
+            glBufferData(GL_ARRAY_BUFFER, vertexBytes, nullptr, GL_STATIC_DRAW);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers[1]);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indexBytes, nullptr, GL_STATIC_DRAW);
+            Mesh::EnableAttributes(layout);
+
+            unsigned int baseVertex = 0, firstIndex = 0;
+            glBindBuffer(GL_COPY_WRITE_BUFFER, buffers[0]);
+            for(size_t i : group)
+            {
+                Mesh& mesh = meshes[i];
+                glBindBuffer(GL_COPY_READ_BUFFER, mesh.VertexBuffer());
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, (GLintptr) baseVertex * layout.stride,
+                                    (GLsizeiptr) mesh.VertexCount * layout.stride);
+                glBindBuffer(GL_COPY_READ_BUFFER, mesh.IndexBuffer());
+                glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_ELEMENT_ARRAY_BUFFER, 0, (GLintptr) (firstIndex * Mesh::IndexSize(indexType)),
+                                    (GLsizeiptr) (mesh.IndexCount * Mesh::IndexSize(indexType)));
+                mesh.ShareBuffers(vao, (int) baseVertex, firstIndex);
+                baseVertex += mesh.VertexCount;
+                firstIndex += mesh.IndexCount;
+            }
+            GLState::Get().BindVertexArray(0);
+            sharedGeometry.arrays.push_back(vao);
+            sharedGeometry.buffers.insert(sharedGeometry.buffers.end(), buffers, buffers + 2);
+        }
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
@@ -191,37 +577,51 @@ private:
         {
             aiString str;
             mat->GetTexture(type, i, &str);
-            // check if texture was loaded before and if so, continue to next iteration: skip loading a new texture
-            bool skip = false;
-            for(unsigned int j = 0; j < textures_loaded.size(); j++)
-            {
-                if(std::strcmp(textures_loaded[j].path.data(), str.C_Str()) == 0)
-                {
-                    textures.push_back(textures_loaded[j]);
-                    skip = true; // a texture with the same filepath has already been loaded, continue to next one. (optimization)
-                    break;
-                }
-            }
-            if(!skip)
-            {   // if texture hasn't been loaded already, load it
-                Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
-                texture.type = typeName;
-                texture.path = str.C_Str();
-                textures.push_back(texture);
-                textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecesery load duplicate textures.
-            }
+            textures.push_back(loadMaterialTexture(str.C_Str(), typeName));
         }
         return textures;
     }
+
+    // the model's handle to a texture, shared with every other user of the same image through the
+    // resource manager
+    Texture loadMaterialTexture(const char *path, const string &typeName)
+    {
+        ResourceHandle<TextureResource>& handle = textureHandles[path];
+        bool loaded = handle != nullptr;
+        if(!loaded)
+            handle = acquireTexture(path);
+        Texture texture;
+        texture.id = handle->id;
+        texture.type = typeName;
+        texture.path = path;
+        if(!loaded)
+            textures_loaded.push_back(texture);
+        return texture;
+    }
+
+    ResourceHandle<TextureResource> acquireTexture(const char *path)
+    {
+        string filename = directory + '/' + path;
+        if(streamer)
+            return ResourceManager::Get().LoadTexture(filename, *streamer);
+        // TextureFromFile uploads with the streamer's default settings
+        return ResourceManager::Get().Textures().Acquire({filename}, ResourceManager::TextureVariant(GL_TEXTURE_2D, StreamedTextureSettings()), [&]() {
+            return std::make_shared<TextureResource>(TextureFromFile(path, directory, false, nullptr));
+        });
+    }
 };
 
 
-unsigned int TextureFromFile(const char *path, const string &directory, bool gamma)
+unsigned int TextureFromFile(const char *path, const string &directory, bool gamma, TextureStreamer *streamer)
 {
+    RG_PROFILE_FUNCTION();
     string filename = string(path);
     filename = directory + '/' + filename;
 
+    // decoded on a worker and uploaded by the streamer, the id is valid right away
+    if (streamer)
+        return streamer->Request(filename);
+
     unsigned int textureID;
     glGenTextures(1, &textureID);
 
@@ -8,7 +8,20 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <unordered_map>
 #include <common.h>
+#include <rg/GLState.h>
+#include <rg/CpuProfiler.h>
+
+// an active uniform as reported by the program after linking
+struct UniformInfo
+{
+    int location;
+    GLenum type;
+    int size;
+};
+
 class Shader
 {
 public:
@@ -17,6 +30,7 @@ public:
     // ------------------------------------------------------------------------
     Shader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr)
     {
+        RG_PROFILE_FUNCTION();
         std::string vertexPathString(vertexPath);
         std::string fragmentPathString(fragmentPath);
 
@@ -96,6 +110,7 @@ public:
             glAttachShader(ID, geometry);
         glLinkProgram(ID);
         checkCompileErrors(ID, "PROGRAM");
+        reflectUniforms();
         // delete the shaders as they're linked into our program now and no longer necessery
         glDeleteShader(vertex);
         glDeleteShader(fragment);
@@ -103,72 +118,184 @@ public:
             glDeleteShader(geometry);
 
     }
+    // constructor for a program that only feeds transform feedback: a vertex and a geometry
+    // shader whose outputs listed in feedbackVaryings are captured into interleaved buffers
+    // ------------------------------------------------------------------------
+    Shader(const char* vertexPath, const char* geometryPath, const std::vector<const char*>& feedbackVaryings)
+    {
+        RG_PROFILE_FUNCTION();
+        std::string vertexCode = readFileContents(vertexPath);
+        std::string geometryCode = readFileContents(geometryPath);
+        if(vertexCode.empty() || geometryCode.empty())
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ" << std::endl;
+        const char* vShaderCode = vertexCode.c_str();
+        const char* gShaderCode = geometryCode.c_str();
+        unsigned int vertex = glCreateShader(GL_VERTEX_SHADER);
+        glShaderSource(vertex, 1, &vShaderCode, NULL);
+        glCompileShader(vertex);
+        checkCompileErrors(vertex, "VERTEX");
+        unsigned int geometry = glCreateShader(GL_GEOMETRY_SHADER);
+        glShaderSource(geometry, 1, &gShaderCode, NULL);
+        glCompileShader(geometry);
+        checkCompileErrors(geometry, "GEOMETRY");
+        ID = glCreateProgram();
+        glAttachShader(ID, vertex);
+        glAttachShader(ID, geometry);
+        // varyings have to be declared before linking
+        glTransformFeedbackVaryings(ID, (GLsizei) feedbackVaryings.size(), feedbackVaryings.data(), GL_INTERLEAVED_ATTRIBS);
+        glLinkProgram(ID);
+        checkCompileErrors(ID, "PROGRAM");
+        reflectUniforms();
+        glDeleteShader(vertex);
+        glDeleteShader(geometry);
+    }
     // activate the shader
     // ------------------------------------------------------------------------
     void use() 
     { 
-        glUseProgram(ID); 
+        GLState::Get().UseProgram(ID);
+    }
+    // uniform locations
+    // ------------------------------------------------------------------------
+    // looks the name up in the table built after linking, -1 if the program has no such
+    // active uniform. Hot code should resolve its locations once and keep them.
+    int getUniformLocation(const std::string &name) const
+    {
+        auto it = uniforms.find(name);
+        return it != uniforms.end() ? it->second.location : -1;
+    }
+    const std::unordered_map<std::string, UniformInfo>& activeUniforms() const
+    {
+        return uniforms;
+    }
+    // attaches a uniform block to a binding point, nothing happens if the program does not use the block
+    void bindUniformBlock(const char *blockName, unsigned int binding) const
+    {
+        GLuint index = glGetUniformBlockIndex(ID, blockName);
+        if (index != GL_INVALID_INDEX)
+            glUniformBlockBinding(ID, index, binding);
     }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {         
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value); 
+        setBool(getUniformLocation(name), value);
+    }
+    void setBool(int location, bool value) const
+    {
+        glUniform1i(location, (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     { 
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value); 
+        setInt(getUniformLocation(name), value);
+    }
+    void setInt(int location, int value) const
+    {
+        glUniform1i(location, value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     { 
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value); 
+        setFloat(getUniformLocation(name), value);
+    }
+    void setFloat(int location, float value) const
+    {
+        glUniform1f(location, value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     { 
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setVec2(getUniformLocation(name), value);
+    }
+    void setVec2(int location, const glm::vec2 &value) const
+    {
+        glUniform2fv(location, 1, &value[0]);
     }
     void setVec2(const std::string &name, float x, float y) const
     { 
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y); 
+        glUniform2f(getUniformLocation(name), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     { 
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setVec3(getUniformLocation(name), value);
+    }
+    void setVec3(int location, const glm::vec3 &value) const
+    {
+        glUniform3fv(location, 1, &value[0]);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     { 
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z); 
+        glUniform3f(getUniformLocation(name), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     { 
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]); 
+        setVec4(getUniformLocation(name), value);
+    }
+    void setVec4(int location, const glm::vec4 &value) const
+    {
+        glUniform4fv(location, 1, &value[0]);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w) 
     { 
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w); 
+        glUniform4f(getUniformLocation(name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat4(getUniformLocation(name), mat);
+    }
+    void setMat4(int location, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    std::unordered_map<std::string, UniformInfo> uniforms;
+
+    // enumerates the active uniforms once after linking. Arrays are reported as "name[0]",
+    // they are also stored under "name" and every "name[i]".
+    void reflectUniforms()
+    {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(ID, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; i++)
+        {
+            GLsizei length = 0;
+            UniformInfo info;
+            glGetActiveUniform(ID, (GLuint)i, maxLength, &length, &info.size, &info.type, buffer.data());
+            std::string name(buffer.data(), length);
+            info.location = glGetUniformLocation(ID, name.c_str());
+            if (info.location < 0) // uniforms inside uniform blocks have no location
+                continue;
+            uniforms[name] = info;
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0)
+            {
+                std::string base = name.substr(0, name.size() - 3);
+                uniforms[base] = info;
+                for (int element = 1; element < info.size; element++)
+                {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    uniforms[elementName] = {glGetUniformLocation(ID, elementName.c_str()), info.type, 1};
+                }
+            }
+        }
+    }
+
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
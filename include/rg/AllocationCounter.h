@@ -0,0 +1,82 @@
+#ifndef PROJECT_BASE_ALLOCATIONCOUNTER_H
+#define PROJECT_BASE_ALLOCATIONCOUNTER_H
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// Counts calls of the global operator new on every thread. The replacement operators are compiled
+// into the one translation unit that defines RG_ALLOCATION_COUNTER_IMPLEMENTATION and includes this
+// header. Without it the counts stay 0. Memory from malloc (ImGui, GLFW, the driver) is not counted.
+class AllocationCounter {
+public:
+    static unsigned long long Allocations() { return allocations().load(std::memory_order_relaxed); }
+    static unsigned long long Bytes() { return bytes().load(std::memory_order_relaxed); }
+
+    static void Count(size_t size) {
+        allocations().fetch_add(1, std::memory_order_relaxed);
+        bytes().fetch_add(size, std::memory_order_relaxed);
+    }
+
+private:
+    static std::atomic<unsigned long long>& allocations() {
+        static std::atomic<unsigned long long> count{0};
+        return count;
+    }
+
+    static std::atomic<unsigned long long>& bytes() {
+        static std::atomic<unsigned long long> count{0};
+        return count;
+    }
+};
+
+#endif //PROJECT_BASE_ALLOCATIONCOUNTER_H
+
+// outside the include guard, so the implementation is compiled even when another header included
+// this one before RG_ALLOCATION_COUNTER_IMPLEMENTATION was defined
+#if defined(RG_ALLOCATION_COUNTER_IMPLEMENTATION) && !defined(PROJECT_BASE_ALLOCATIONCOUNTER_IMPLEMENTED)
+#define PROJECT_BASE_ALLOCATIONCOUNTER_IMPLEMENTED
+
+namespace allocationcounter {
+
+inline void* allocate(size_t size) {
+    AllocationCounter::Count(size);
+    for (;;) {
+        if (void* pointer = std::malloc(size == 0 ? 1 : size))
+            return pointer;
+        std::new_handler handler = std::get_new_handler();
+        if (handler == nullptr)
+            throw std::bad_alloc();
+        handler();
+    }
+}
+
+} // namespace allocationcounter
+
+void* operator new(size_t size) { return allocationcounter::allocate(size); }
+void* operator new[](size_t size) { return allocationcounter::allocate(size); }
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return allocationcounter::allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return allocationcounter::allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void operator delete(void* pointer) noexcept { std::free(pointer); }
+void operator delete[](void* pointer) noexcept { std::free(pointer); }
+void operator delete(void* pointer, size_t) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { std::free(pointer); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { std::free(pointer); }
+
+#endif // RG_ALLOCATION_COUNTER_IMPLEMENTATION
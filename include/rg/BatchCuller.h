@@ -0,0 +1,274 @@
+#ifndef PROJECT_BASE_BATCHCULLER_H
+#define PROJECT_BASE_BATCHCULLER_H
+
+#include <glm/glm.hpp>
+#include <rg/Frustum.h>
+#include <vector>
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RG_CULLING_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// the SIMD kernels are compiled for their instruction set regardless of the global -m flags
+// and only called after the CPU has been checked
+#if defined(RG_CULLING_X86) && (defined(__GNUC__) || defined(__clang__))
+#define RG_TARGET_SSE __attribute__((target("sse2")))
+#define RG_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define RG_TARGET_SSE
+#define RG_TARGET_AVX2
+#endif
+
+enum CullPath {
+    CULL_PATH_SCALAR = 0,
+    CULL_PATH_SSE,          // 4 boxes per iteration
+    CULL_PATH_AVX2,         // 8 boxes per iteration
+    CULL_PATH_COUNT
+};
+
+inline const char* CullPathName(int path) {
+    static const char* names[CULL_PATH_COUNT] = {"scalar", "SSE", "AVX2"};
+    return names[path];
+}
+
+// Axis aligned boxes stored as center and extents, one array per component, so consecutive boxes
+// load straight into SIMD lanes. Arrays are padded with zeros to a multiple of 8 boxes.
+class BoundsSoA {
+public:
+    enum { CenterX = 0, CenterY, CenterZ, ExtentX, ExtentY, ExtentZ, ComponentCount };
+    static const size_t Padding = 8;
+
+    unsigned int Add(const glm::vec3& min, const glm::vec3& max) {
+        if (m_Count == m_Components[0].size()) {
+            for (std::vector<float>& component : m_Components)
+                component.resize(m_Count + Padding, 0.0f);
+        }
+        Set(m_Count, min, max);
+        return (unsigned int) m_Count++;
+    }
+
+    void Set(size_t index, const glm::vec3& min, const glm::vec3& max) {
+        glm::vec3 center = 0.5f * (min + max);
+        glm::vec3 extents = 0.5f * (max - min);
+        for (int axis = 0; axis < 3; axis++) {
+            m_Components[CenterX + axis][index] = center[axis];
+            m_Components[ExtentX + axis][index] = extents[axis];
+        }
+    }
+
+    void Clear() {
+        m_Count = 0;
+        for (std::vector<float>& component : m_Components)
+            component.clear();
+    }
+
+    size_t Size() const { return m_Count; }
+    const float* Component(int component) const { return m_Components[component].data(); }
+
+private:
+    std::vector<float> m_Components[ComponentCount];
+    size_t m_Count = 0;
+};
+
+namespace batchculling {
+
+// frustum planes split into components, with the absolute normals used for the box extents
+struct Planes {
+    float nx[Frustum::PlaneCount], ny[Frustum::PlaneCount], nz[Frustum::PlaneCount], d[Frustum::PlaneCount];
+    float ax[Frustum::PlaneCount], ay[Frustum::PlaneCount], az[Frustum::PlaneCount];
+
+    explicit Planes(const Frustum& frustum) {
+        for (int p = 0; p < Frustum::PlaneCount; p++) {
+            const Plane& plane = frustum.planes[p];
+            nx[p] = plane.normal.x;
+            ny[p] = plane.normal.y;
+            nz[p] = plane.normal.z;
+            d[p] = plane.distance;
+            ax[p] = glm::abs(nx[p]);
+            ay[p] = glm::abs(ny[p]);
+            az[p] = glm::abs(nz[p]);
+        }
+    }
+};
+
+inline int lowestBit(unsigned int mask) {
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return (int) index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
+
+// appends first + i for every set bit i of mask
+inline size_t emit(unsigned int mask, unsigned int first, unsigned int* out, size_t written) {
+    while (mask != 0) {
+        out[written++] = first + lowestBit(mask);
+        mask &= mask - 1;
+    }
+    return written;
+}
+
+// Reference path. A box is outside when it is entirely behind one plane, that is when the
+// center distance plus the extents projected on the normal is negative. The SIMD paths
+// evaluate the same expression in the same order, so their results match exactly.
+inline size_t cullScalar(const Planes& planes, const BoundsSoA& bounds, unsigned int* out) {
+    const float* cx = bounds.Component(BoundsSoA::CenterX);
+    const float* cy = bounds.Component(BoundsSoA::CenterY);
+    const float* cz = bounds.Component(BoundsSoA::CenterZ);
+    const float* ex = bounds.Component(BoundsSoA::ExtentX);
+    const float* ey = bounds.Component(BoundsSoA::ExtentY);
+    const float* ez = bounds.Component(BoundsSoA::ExtentZ);
+    size_t written = 0;
+    for (size_t i = 0; i < bounds.Size(); i++) {
+        bool visible = true;
+        for (int p = 0; p < Frustum::PlaneCount && visible; p++) {
+            float distance = planes.nx[p] * cx[i] + planes.ny[p] * cy[i] + planes.nz[p] * cz[i] + planes.d[p];
+            float radius = planes.ax[p] * ex[i] + planes.ay[p] * ey[i] + planes.az[p] * ez[i];
+            visible = distance + radius >= 0.0f;
+        }
+        if (visible)
+            out[written++] = (unsigned int) i;
+    }
+    return written;
+}
+
+#ifdef RG_CULLING_X86
+RG_TARGET_SSE inline size_t cullSSE(const Planes& planes, const BoundsSoA& bounds, unsigned int* out) {
+    const float* cx = bounds.Component(BoundsSoA::CenterX);
+    const float* cy = bounds.Component(BoundsSoA::CenterY);
+    const float* cz = bounds.Component(BoundsSoA::CenterZ);
+    const float* ex = bounds.Component(BoundsSoA::ExtentX);
+    const float* ey = bounds.Component(BoundsSoA::ExtentY);
+    const float* ez = bounds.Component(BoundsSoA::ExtentZ);
+    const __m128 zero = _mm_setzero_ps();
+    size_t count = bounds.Size();
+    size_t written = 0;
+    for (size_t i = 0; i < count; i += 4) {
+        __m128 x = _mm_loadu_ps(cx + i), y = _mm_loadu_ps(cy + i), z = _mm_loadu_ps(cz + i);
+        __m128 sx = _mm_loadu_ps(ex + i), sy = _mm_loadu_ps(ey + i), sz = _mm_loadu_ps(ez + i);
+        int mask = 0xf;
+        for (int p = 0; p < Frustum::PlaneCount && mask != 0; p++) {
+            __m128 distance = _mm_add_ps(_mm_add_ps(_mm_add_ps(
+                    _mm_mul_ps(_mm_set1_ps(planes.nx[p]), x),
+                    _mm_mul_ps(_mm_set1_ps(planes.ny[p]), y)),
+                    _mm_mul_ps(_mm_set1_ps(planes.nz[p]), z)),
+                    _mm_set1_ps(planes.d[p]));
+            __m128 radius = _mm_add_ps(_mm_add_ps(
+                    _mm_mul_ps(_mm_set1_ps(planes.ax[p]), sx),
+                    _mm_mul_ps(_mm_set1_ps(planes.ay[p]), sy)),
+                    _mm_mul_ps(_mm_set1_ps(planes.az[p]), sz));
+            mask &= _mm_movemask_ps(_mm_cmpge_ps(_mm_add_ps(distance, radius), zero));
+        }
+        // padding lanes past the last box
+        if (i + 4 > count)
+            mask &= (1 << (count - i)) - 1;
+        written = emit((unsigned int) mask, (unsigned int) i, out, written);
+    }
+    return written;
+}
+
+RG_TARGET_AVX2 inline size_t cullAVX2(const Planes& planes, const BoundsSoA& bounds, unsigned int* out) {
+    const float* cx = bounds.Component(BoundsSoA::CenterX);
+    const float* cy = bounds.Component(BoundsSoA::CenterY);
+    const float* cz = bounds.Component(BoundsSoA::CenterZ);
+    const float* ex = bounds.Component(BoundsSoA::ExtentX);
+    const float* ey = bounds.Component(BoundsSoA::ExtentY);
+    const float* ez = bounds.Component(BoundsSoA::ExtentZ);
+    const __m256 zero = _mm256_setzero_ps();
+    size_t count = bounds.Size();
+    size_t written = 0;
+    for (size_t i = 0; i < count; i += 8) {
+        __m256 x = _mm256_loadu_ps(cx + i), y = _mm256_loadu_ps(cy + i), z = _mm256_loadu_ps(cz + i);
+        __m256 sx = _mm256_loadu_ps(ex + i), sy = _mm256_loadu_ps(ey + i), sz = _mm256_loadu_ps(ez + i);
+        int mask = 0xff;
+        for (int p = 0; p < Frustum::PlaneCount && mask != 0; p++) {
+            __m256 distance = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(
+                    _mm256_mul_ps(_mm256_set1_ps(planes.nx[p]), x),
+                    _mm256_mul_ps(_mm256_set1_ps(planes.ny[p]), y)),
+                    _mm256_mul_ps(_mm256_set1_ps(planes.nz[p]), z)),
+                    _mm256_set1_ps(planes.d[p]));
+            __m256 radius = _mm256_add_ps(_mm256_add_ps(
+                    _mm256_mul_ps(_mm256_set1_ps(planes.ax[p]), sx),
+                    _mm256_mul_ps(_mm256_set1_ps(planes.ay[p]), sy)),
+                    _mm256_mul_ps(_mm256_set1_ps(planes.az[p]), sz));
+            mask &= _mm256_movemask_ps(_mm256_cmp_ps(_mm256_add_ps(distance, radius), zero, _CMP_GE_OQ));
+        }
+        if (i + 8 > count)
+            mask &= (1 << (count - i)) - 1;
+        written = emit((unsigned int) mask, (unsigned int) i, out, written);
+    }
+    return written;
+}
+#endif
+
+inline bool cpuSupports(int path) {
+#ifdef RG_CULLING_X86
+#ifdef _MSC_VER
+    int info[4];
+    __cpuid(info, 1);
+    if (path == CULL_PATH_SSE)
+        return (info[3] & (1 << 26)) != 0;
+    // AVX2 also needs the OS to save the ymm registers
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+        return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return path == CULL_PATH_SSE ? __builtin_cpu_supports("sse2") : __builtin_cpu_supports("avx2");
+#endif
+#else
+    return false;
+#endif
+}
+
+} // namespace batchculling
+
+inline bool CullPathSupported(int path) {
+    return path == CULL_PATH_SCALAR || batchculling::cpuSupports(path);
+}
+
+// widest path the CPU runs, detected once
+inline CullPath DefaultCullPath() {
+    static const CullPath path = CullPathSupported(CULL_PATH_AVX2) ? CULL_PATH_AVX2
+                                 : CullPathSupported(CULL_PATH_SSE) ? CULL_PATH_SSE : CULL_PATH_SCALAR;
+    return path;
+}
+
+// Writes the indices of the boxes intersecting the frustum into visible, in increasing order,
+// and returns how many there are. Unsupported paths fall back to the scalar one.
+inline size_t CullBounds(const Frustum& frustum, const BoundsSoA& bounds, std::vector<unsigned int>& visible,
+                         CullPath path = DefaultCullPath()) {
+    visible.resize(bounds.Size());
+    batchculling::Planes planes(frustum);
+    size_t written = 0;
+    if (bounds.Size() > 0) {
+        if (!CullPathSupported(path))
+            path = CULL_PATH_SCALAR;
+        switch (path) {
+#ifdef RG_CULLING_X86
+            case CULL_PATH_AVX2:
+                written = batchculling::cullAVX2(planes, bounds, visible.data());
+                break;
+            case CULL_PATH_SSE:
+                written = batchculling::cullSSE(planes, bounds, visible.data());
+                break;
+#endif
+            default:
+                written = batchculling::cullScalar(planes, bounds, visible.data());
+                break;
+        }
+    }
+    visible.resize(written);
+    return written;
+}
+
+#endif //PROJECT_BASE_BATCHCULLER_H
@@ -0,0 +1,189 @@
+#ifndef PROJECT_BASE_BLOCKCOMPRESSION_H
+#define PROJECT_BASE_BLOCKCOMPRESSION_H
+
+#include <glad/glad.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// S3TC is an extension to GL 3.3, the loader only knows the core enums
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+#define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+enum BlockFormat {
+    BLOCK_BC1,      // opaque RGB, 8 bytes per 4x4 block
+    BLOCK_BC3,      // RGB + smooth alpha, 16 bytes per block
+    BLOCK_RGTC1     // single channel, 8 bytes per block
+};
+
+inline GLenum BlockFormatInternalFormat(BlockFormat format) {
+    return format == BLOCK_BC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+           : format == BLOCK_BC3 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+           : GL_COMPRESSED_RED_RGTC1;
+}
+
+inline const char* BlockFormatName(BlockFormat format) {
+    return format == BLOCK_BC1 ? "BC1" : format == BLOCK_BC3 ? "BC3" : "RGTC1";
+}
+
+inline size_t BlockFormatBlockBytes(BlockFormat format) {
+    return format == BLOCK_BC3 ? 16 : 8;
+}
+
+inline size_t BlockCompressedSize(BlockFormat format, int width, int height) {
+    return (size_t) ((width + 3) / 4) * ((height + 3) / 4) * BlockFormatBlockBytes(format);
+}
+
+namespace blockcompression {
+
+inline uint16_t packColor(const float color[3]) {
+    int r = (int) std::lround(std::min(std::max(color[0], 0.0f), 255.0f) * 31.0f / 255.0f);
+    int g = (int) std::lround(std::min(std::max(color[1], 0.0f), 255.0f) * 63.0f / 255.0f);
+    int b = (int) std::lround(std::min(std::max(color[2], 0.0f), 255.0f) * 31.0f / 255.0f);
+    return (uint16_t) ((r << 11) | (g << 5) | b);
+}
+
+inline void unpackColor(uint16_t packed, int color[3]) {
+    int r = (packed >> 11) & 31, g = (packed >> 5) & 63, b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+} // namespace blockcompression
+
+// Color part of BC1/BC3, always in four color mode. The endpoints are the extremes of the texels
+// along their principal axis, pulled in by 1/16 of the range so the quantization error is spread
+// over both ends.
+inline void EncodeColorBlock(const unsigned char rgba[64], unsigned char out[8]) {
+    using namespace blockcompression;
+    float mean[3] = {0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < 16; i++)
+        for (int c = 0; c < 3; c++)
+            mean[c] += rgba[4 * i + c] / 16.0f;
+    float covariance[6] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};   // rr rg rb gg gb bb
+    for (int i = 0; i < 16; i++) {
+        float d[3] = {rgba[4 * i] - mean[0], rgba[4 * i + 1] - mean[1], rgba[4 * i + 2] - mean[2]};
+        covariance[0] += d[0] * d[0]; covariance[1] += d[0] * d[1]; covariance[2] += d[0] * d[2];
+        covariance[3] += d[1] * d[1]; covariance[4] += d[1] * d[2]; covariance[5] += d[2] * d[2];
+    }
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (int iteration = 0; iteration < 8; iteration++) {
+        float next[3] = {covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+                         covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+                         covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]};
+        float length = std::max(std::abs(next[0]), std::max(std::abs(next[1]), std::abs(next[2])));
+        if (length < 1e-6f)
+            break;
+        for (int c = 0; c < 3; c++)
+            axis[c] = next[c] / length;
+    }
+
+    float lowest = 1e30f, highest = -1e30f;
+    for (int i = 0; i < 16; i++) {
+        float t = (rgba[4 * i] - mean[0]) * axis[0] + (rgba[4 * i + 1] - mean[1]) * axis[1] + (rgba[4 * i + 2] - mean[2]) * axis[2];
+        lowest = std::min(lowest, t);
+        highest = std::max(highest, t);
+    }
+    float axisLength2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    float inset = (highest - lowest) / 16.0f;
+    float minColor[3], maxColor[3];
+    for (int c = 0; c < 3; c++) {
+        float scale = axisLength2 > 0.0f ? axis[c] / axisLength2 : 0.0f;
+        minColor[c] = mean[c] + (lowest + inset) * scale;
+        maxColor[c] = mean[c] + (highest - inset) * scale;
+    }
+
+    uint16_t color0 = packColor(maxColor), color1 = packColor(minColor);
+    if (color0 < color1)
+        std::swap(color0, color1);
+    uint32_t indices = 0;
+    if (color0 != color1) {
+        int palette[4][3];
+        unpackColor(color0, palette[0]);
+        unpackColor(color1, palette[1]);
+        for (int c = 0; c < 3; c++) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+        for (int i = 0; i < 16; i++) {
+            int best = 0, bestError = 1 << 30;
+            for (int p = 0; p < 4; p++) {
+                int dr = rgba[4 * i] - palette[p][0], dg = rgba[4 * i + 1] - palette[p][1], db = rgba[4 * i + 2] - palette[p][2];
+                int error = dr * dr + dg * dg + db * db;
+                if (error < bestError) {
+                    best = p;
+                    bestError = error;
+                }
+            }
+            indices |= (uint32_t) best << (2 * i);
+        }
+    }
+    out[0] = (unsigned char) (color0 & 0xff);
+    out[1] = (unsigned char) (color0 >> 8);
+    out[2] = (unsigned char) (color1 & 0xff);
+    out[3] = (unsigned char) (color1 >> 8);
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (unsigned char) (indices >> (8 * i));
+}
+
+// BC4 / RGTC1 block, also the alpha half of BC3: min and max as endpoints in eight value mode
+inline void EncodeSingleChannelBlock(const unsigned char values[16], unsigned char out[8]) {
+    int value0 = *std::max_element(values, values + 16);
+    int value1 = *std::min_element(values, values + 16);
+    uint64_t indices = 0;
+    if (value0 != value1) {
+        int palette[8] = {value0, value1};
+        for (int p = 2; p < 8; p++)
+            palette[p] = ((8 - p) * value0 + (p - 1) * value1) / 7;
+        for (int i = 0; i < 16; i++) {
+            int best = 0;
+            for (int p = 1; p < 8; p++) {
+                if (std::abs(values[i] - palette[p]) < std::abs(values[i] - palette[best]))
+                    best = p;
+            }
+            indices |= (uint64_t) best << (3 * i);
+        }
+    }
+    out[0] = (unsigned char) value0;
+    out[1] = (unsigned char) value1;
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (unsigned char) (indices >> (8 * i));
+}
+
+// Compresses an RGBA8 image, edge blocks repeat the last row and column. RGTC1 takes the red channel.
+inline std::vector<unsigned char> CompressImage(const unsigned char* rgba, int width, int height, BlockFormat format) {
+    std::vector<unsigned char> blocks(BlockCompressedSize(format, width, height));
+    unsigned char* out = blocks.data();
+    for (int by = 0; by < height; by += 4) {
+        for (int bx = 0; bx < width; bx += 4) {
+            unsigned char texels[64], channel[16];
+            for (int i = 0; i < 16; i++) {
+                int x = std::min(bx + i % 4, width - 1), y = std::min(by + i / 4, height - 1);
+                std::copy(rgba + 4 * ((size_t) y * width + x), rgba + 4 * ((size_t) y * width + x) + 4, texels + 4 * i);
+            }
+            if (format == BLOCK_BC3) {
+                for (int i = 0; i < 16; i++)
+                    channel[i] = texels[4 * i + 3];
+                EncodeSingleChannelBlock(channel, out);
+                out += 8;
+            }
+            if (format == BLOCK_RGTC1) {
+                for (int i = 0; i < 16; i++)
+                    channel[i] = texels[4 * i];
+                EncodeSingleChannelBlock(channel, out);
+            } else {
+                EncodeColorBlock(texels, out);
+            }
+            out += 8;
+        }
+    }
+    return blocks;
+}
+
+#endif //PROJECT_BASE_BLOCKCOMPRESSION_H
@@ -0,0 +1,159 @@
+#ifndef PROJECT_BASE_CAMERATRACK_H
+#define PROJECT_BASE_CAMERATRACK_H
+
+#include <glm/glm.hpp>
+#include <learnopengl/camera.h>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// camera pose of one frame and the deltaTime the frame was rendered with
+struct CameraSample {
+    float deltaTime;
+    float position[3];
+    float yaw;
+    float pitch;
+    float zoom;
+};
+
+static_assert(sizeof(CameraSample) == 7 * sizeof(float), "camera samples are stored as they are in memory");
+
+// A recorded camera path. On disk: the magic "RGCT", a format version and the sample count as
+// 32 bit integers, followed by the samples as raw little endian floats.
+class CameraTrack {
+public:
+    static const uint32_t Version = 1;
+
+    void Clear() { m_Samples.clear(); m_Duration = 0.0f; }
+
+    void Add(const Camera& camera, float deltaTime) {
+        CameraSample sample;
+        sample.deltaTime = deltaTime;
+        std::memcpy(sample.position, &camera.Position[0], sizeof(sample.position));
+        sample.yaw = camera.Yaw;
+        sample.pitch = camera.Pitch;
+        sample.zoom = camera.Zoom;
+        m_Samples.push_back(sample);
+        m_Duration += deltaTime;
+    }
+
+    bool Save(const std::string& path) const {
+        std::ofstream out(path, std::ios::binary);
+        if (!out)
+            return false;
+        uint32_t header[3] = {Magic, Version, (uint32_t) m_Samples.size()};
+        out.write(reinterpret_cast<const char*>(header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(m_Samples.data()), m_Samples.size() * sizeof(CameraSample));
+        return (bool) out;
+    }
+
+    bool Load(const std::string& path) {
+        Clear();
+        std::ifstream in(path, std::ios::binary | std::ios::ate);
+        std::streamoff size = in.tellg();
+        in.seekg(0);
+        uint32_t header[3] = {};
+        if (!in.read(reinterpret_cast<char*>(header), sizeof(header)) || header[0] != Magic || header[1] != Version)
+            return false;
+        // a truncated or corrupt count must not allocate more than the file holds
+        if ((uint64_t) header[2] * sizeof(CameraSample) > (uint64_t) (size - (std::streamoff) sizeof(header)))
+            return false;
+        m_Samples.resize(header[2]);
+        if (!in.read(reinterpret_cast<char*>(m_Samples.data()), m_Samples.size() * sizeof(CameraSample))) {
+            Clear();
+            return false;
+        }
+        for (const CameraSample& sample : m_Samples)
+            m_Duration += sample.deltaTime;
+        return true;
+    }
+
+    size_t Size() const { return m_Samples.size(); }
+    bool Empty() const { return m_Samples.empty(); }
+    const CameraSample& operator[](size_t i) const { return m_Samples[i]; }
+    // sum of the recorded frame times
+    float Duration() const { return m_Duration; }
+
+private:
+    static const uint32_t Magic = 0x54434752; // "RGCT"
+    std::vector<CameraSample> m_Samples;
+    float m_Duration = 0.0f;
+};
+
+enum PlaybackMode {
+    PLAYBACK_RECORDED_FRAMES = 0,   // one recorded frame per rendered frame, with its recorded deltaTime
+    PLAYBACK_FIXED_STEP,            // the track time advances by a fixed step per rendered frame
+    PLAYBACK_REAL_TIME              // the track time follows the wall clock, at recorded speed
+};
+
+// Drives a Camera along a track. Both the recorded frame and the fixed step modes depend only on
+// the track, never on how long frames take, so every run renders exactly the same views.
+class CameraPlayer {
+public:
+    void Start(const CameraTrack* track, PlaybackMode mode, float fixedStep = 1.0f / 60.0f) {
+        m_Track = track;
+        m_Mode = mode;
+        m_FixedStep = fixedStep;
+        m_Frame = 0;
+        m_Time = 0.0f;
+        m_FrameStart = 0.0f;
+        m_Playing = track != nullptr && !track->Empty();
+    }
+
+    void Stop() { m_Playing = false; }
+    bool Playing() const { return m_Playing; }
+
+    // Poses the camera for the next frame and returns the deltaTime the frame should use.
+    // realDeltaTime is only used by PLAYBACK_REAL_TIME.
+    float Advance(Camera& camera, float realDeltaTime) {
+        if (!m_Playing)
+            return realDeltaTime;
+        const CameraTrack& track = *m_Track;
+        float deltaTime;
+        if (m_Mode == PLAYBACK_RECORDED_FRAMES) {
+            const CameraSample& sample = track[m_Frame];
+            apply(camera, sample, sample, 0.0f);
+            deltaTime = sample.deltaTime;
+            m_Playing = ++m_Frame < track.Size();
+            return deltaTime;
+        }
+
+        deltaTime = m_Mode == PLAYBACK_FIXED_STEP ? m_FixedStep : realDeltaTime;
+        m_Time += deltaTime;
+        // frame i + 1 was recorded deltaTime[i + 1] after frame i, find the pair around m_Time
+        while (m_Frame + 1 < track.Size() && m_FrameStart + track[m_Frame + 1].deltaTime < m_Time) {
+            m_Frame++;
+            m_FrameStart += track[m_Frame].deltaTime;
+        }
+        if (m_Frame + 1 >= track.Size()) {
+            apply(camera, track[m_Frame], track[m_Frame], 0.0f);
+            m_Playing = false;
+            return deltaTime;
+        }
+        float length = track[m_Frame + 1].deltaTime;
+        float t = length > 0.0f ? glm::clamp((m_Time - m_FrameStart) / length, 0.0f, 1.0f) : 1.0f;
+        apply(camera, track[m_Frame], track[m_Frame + 1], t);
+        return deltaTime;
+    }
+
+    size_t Frame() const { return m_Frame; }
+
+private:
+    const CameraTrack* m_Track = nullptr;
+    PlaybackMode m_Mode = PLAYBACK_RECORDED_FRAMES;
+    float m_FixedStep = 1.0f / 60.0f;
+    size_t m_Frame = 0;
+    float m_Time = 0.0f;
+    float m_FrameStart = 0.0f;
+    bool m_Playing = false;
+
+    static void apply(Camera& camera, const CameraSample& a, const CameraSample& b, float t) {
+        glm::vec3 position = glm::mix(glm::vec3(a.position[0], a.position[1], a.position[2]),
+                                      glm::vec3(b.position[0], b.position[1], b.position[2]), t);
+        camera.SetPose(position, glm::mix(a.yaw, b.yaw, t), glm::mix(a.pitch, b.pitch, t), glm::mix(a.zoom, b.zoom, t));
+    }
+};
+
+#endif //PROJECT_BASE_CAMERATRACK_H
@@ -0,0 +1,199 @@
+#ifndef PROJECT_BASE_CPUPROFILER_H
+#define PROJECT_BASE_CPUPROFILER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Scoped CPU profiling zones, exported as a chrome://tracing / Perfetto JSON trace.
+//
+//   void Model::loadModel(...) {
+//       RG_PROFILE_FUNCTION();
+//       { RG_PROFILE_ZONE("Read file"); ... }
+//   }
+//
+// Zone names must outlive the profiler, string literals and __func__ do. Without RG_PROFILING the
+// macros expand to nothing and nothing is recorded.
+#ifdef RG_PROFILING
+#define RG_PROFILE_CONCAT_(a, b) a##b
+#define RG_PROFILE_CONCAT(a, b) RG_PROFILE_CONCAT_(a, b)
+#define RG_PROFILE_ZONE(name) CpuProfileZone RG_PROFILE_CONCAT(profileZone, __LINE__)(name)
+#define RG_PROFILE_FUNCTION() RG_PROFILE_ZONE(__func__)
+#define RG_PROFILE_THREAD(name) CpuProfiler::Get().SetThreadName(name)
+#else
+#define RG_PROFILE_ZONE(name) do {} while (0)
+#define RG_PROFILE_FUNCTION() do {} while (0)
+#define RG_PROFILE_THREAD(name) do {} while (0)
+#endif
+
+// text as the contents of a JSON string, quotes, backslashes and control characters escaped
+inline std::string JsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+            escaped += c;
+        } else if ((unsigned char) c < 0x20) {
+            char code[8];
+            std::snprintf(code, sizeof(code), "\\u%04x", (unsigned char) c);
+            escaped += code;
+        } else {
+            escaped += c;
+        }
+    }
+    return escaped;
+}
+
+// Every thread records its zones into its own ring buffer of the last Capacity zones. Only the
+// owning thread writes, so recording takes no lock: the zone is written, then the head is
+// published. The exporting thread copies a buffer and keeps only the zones the writer cannot
+// have overwritten while it was copying.
+class CpuProfiler {
+public:
+    static const size_t Capacity = 1 << 16;
+
+    static CpuProfiler& Get() {
+        static CpuProfiler profiler;
+        return profiler;
+    }
+
+    CpuProfiler(const CpuProfiler&) = delete;
+    CpuProfiler& operator=(const CpuProfiler&) = delete;
+
+    static constexpr bool CompiledIn() {
+#ifdef RG_PROFILING
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // nanoseconds since the profiler was created
+    int64_t Now() const {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - m_Epoch).count();
+    }
+
+    void Record(const char* name, int64_t start, int64_t end) {
+        ThreadBuffer& buffer = threadBuffer();
+        uint64_t head = buffer.head.load(std::memory_order_relaxed);
+        Zone& zone = buffer.zones[head % Capacity];
+        zone.name.store(name, std::memory_order_relaxed);
+        zone.start.store(start, std::memory_order_relaxed);
+        zone.end.store(end, std::memory_order_relaxed);
+        buffer.head.store(head + 1, std::memory_order_release);
+    }
+
+    void SetThreadName(const std::string& name) {
+        ThreadBuffer& buffer = threadBuffer();
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        buffer.name = name;
+    }
+
+    // writes the zones of every thread as complete ("X") events, timestamps in microseconds with
+    // nanosecond digits, fixed point so late zones keep their precision
+    bool WriteChromeTrace(const std::string& path) {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+        out << std::fixed << std::setprecision(3);
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        out << "{\"traceEvents\":[\n";
+        bool first = true;
+        for (size_t tid = 0; tid < m_Threads.size(); tid++) {
+            ThreadBuffer& buffer = *m_Threads[tid];
+            out << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+                << ",\"args\":{\"name\":\"" << JsonEscape(buffer.name) << "\"}}";
+            first = false;
+
+            uint64_t head = buffer.head.load(std::memory_order_acquire);
+            uint64_t begin = head > Capacity ? head - Capacity : 0;
+            std::vector<std::pair<uint64_t, ZoneCopy>> zones;
+            zones.reserve(head - begin);
+            for (uint64_t i = begin; i < head; i++) {
+                const Zone& zone = buffer.zones[i % Capacity];
+                zones.emplace_back(i, ZoneCopy{zone.name.load(std::memory_order_relaxed),
+                                               zone.start.load(std::memory_order_relaxed),
+                                               zone.end.load(std::memory_order_relaxed)});
+            }
+            // Record rewrites slot head % Capacity, which held zone head - Capacity, before it
+            // publishes head + 1, so with the new head after, zones up to after - Capacity may be
+            // torn. The fence keeps the copies above from being read after the new head.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t after = buffer.head.load(std::memory_order_relaxed);
+            uint64_t valid = after + 1 > Capacity ? after + 1 - Capacity : 0;
+            for (const auto& entry : zones) {
+                if (entry.first < valid)
+                    continue;
+                const ZoneCopy& zone = entry.second;
+                out << ",\n{\"name\":\"" << JsonEscape(zone.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+                    << ",\"ts\":" << zone.start / 1000.0 << ",\"dur\":" << (zone.end - zone.start) / 1000.0 << "}";
+            }
+        }
+        out << "\n]}\n";
+        return (bool) out;
+    }
+
+private:
+    struct Zone {
+        std::atomic<const char*> name{nullptr};
+        std::atomic<int64_t> start{0};
+        std::atomic<int64_t> end{0};
+    };
+
+    struct ZoneCopy {
+        const char* name;
+        int64_t start;
+        int64_t end;
+    };
+
+    struct ThreadBuffer {
+        std::atomic<uint64_t> head{0};
+        std::unique_ptr<Zone[]> zones{new Zone[Capacity]};
+        std::string name;
+    };
+
+    std::chrono::steady_clock::time_point m_Epoch = std::chrono::steady_clock::now();
+    std::mutex m_Mutex;
+    // buffers live as long as the profiler, a thread that exits keeps its zones in the trace
+    std::vector<std::unique_ptr<ThreadBuffer>> m_Threads;
+
+    CpuProfiler() = default;
+
+    ThreadBuffer& threadBuffer() {
+        thread_local ThreadBuffer* buffer = nullptr;
+        if (buffer == nullptr) {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Threads.emplace_back(new ThreadBuffer());
+            buffer = m_Threads.back().get();
+            buffer->name = "thread " + std::to_string(m_Threads.size() - 1);
+        }
+        return *buffer;
+    }
+};
+
+class CpuProfileZone {
+public:
+    explicit CpuProfileZone(const char* name)
+            : m_Name(name), m_Start(CpuProfiler::Get().Now()) {}
+
+    ~CpuProfileZone() {
+        CpuProfiler& profiler = CpuProfiler::Get();
+        profiler.Record(m_Name, m_Start, profiler.Now());
+    }
+
+    CpuProfileZone(const CpuProfileZone&) = delete;
+    CpuProfileZone& operator=(const CpuProfileZone&) = delete;
+
+private:
+    const char* m_Name;
+    int64_t m_Start;
+};
+
+#endif //PROJECT_BASE_CPUPROFILER_H
@@ -0,0 +1,63 @@
+#ifndef PROJECT_BASE_CULLINGBENCHMARK_H
+#define PROJECT_BASE_CULLINGBENCHMARK_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <rg/BatchCuller.h>
+#include <rg/Frustum.h>
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+struct CullingBenchmarkResult {
+    int path;
+    bool supported;
+    unsigned int visible;
+    double nsPerBox;
+    bool matchesScalar;
+};
+
+// Microbenchmark of the batch culling paths: random boxes scattered around a camera looking down
+// the -z axis, every supported path timed over the same data and checked index for index against
+// the scalar reference. Results are printed to stdout and returned for the UI.
+inline std::vector<CullingBenchmarkResult> RunCullingBenchmark(unsigned int boxes = 100000, int iterations = 50) {
+    std::mt19937 random(1234);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(0.1f, 4.0f);
+    BoundsSoA bounds;
+    for (unsigned int i = 0; i < boxes; i++) {
+        glm::vec3 min(position(random), position(random) * 0.2f, position(random));
+        bounds.Add(min, min + glm::vec3(size(random), size(random), size(random)));
+    }
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.3f, 1.5f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum(projection * view);
+
+    std::vector<unsigned int> reference;
+    CullBounds(frustum, bounds, reference, CULL_PATH_SCALAR);
+
+    std::vector<CullingBenchmarkResult> results;
+    std::vector<unsigned int> visible;
+    for (int path = 0; path < CULL_PATH_COUNT; path++) {
+        CullingBenchmarkResult result = {path, CullPathSupported(path), 0, 0.0, false};
+        if (result.supported) {
+            auto start = std::chrono::high_resolution_clock::now();
+            for (int i = 0; i < iterations; i++)
+                CullBounds(frustum, bounds, visible, (CullPath) path);
+            std::chrono::duration<double, std::nano> elapsed = std::chrono::high_resolution_clock::now() - start;
+            result.nsPerBox = elapsed.count() / ((double) iterations * boxes);
+            result.visible = (unsigned int) visible.size();
+            result.matchesScalar = visible == reference;
+            printf("culling %-6s %u boxes: %.3f ns/box, %u visible, %s\n", CullPathName(path), boxes,
+                   result.nsPerBox, result.visible, result.matchesScalar ? "matches scalar" : "MISMATCH");
+        } else {
+            printf("culling %-6s not supported on this CPU\n", CullPathName(path));
+        }
+        results.push_back(result);
+    }
+    return results;
+}
+
+#endif //PROJECT_BASE_CULLINGBENCHMARK_H
@@ -0,0 +1,123 @@
+#ifndef PROJECT_BASE_FRAMEARENA_H
+#define PROJECT_BASE_FRAMEARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Linear allocator for memory that lives for one frame. Allocating bumps an offset into one block
+// and freeing does nothing, Reset at the start of a frame releases everything at once.
+// A frame that does not fit gets extra blocks from the heap. The next Reset replaces the main block
+// with one large enough for that frame, so only frames that set a new high-water mark touch the
+// heap. Not thread safe, meant for the GL thread.
+class FrameArena {
+public:
+    explicit FrameArena(size_t capacity = 256 * 1024)
+        : m_Block(new unsigned char[capacity]), m_Capacity(capacity) {}
+
+    FrameArena(const FrameArena&) = delete;
+    FrameArena& operator=(const FrameArena&) = delete;
+
+    void* Allocate(size_t bytes, size_t alignment = alignof(std::max_align_t)) {
+        size_t offset = align(m_Used, alignment);
+        if (offset + bytes <= m_Capacity) {
+            m_Used = offset + bytes;
+            return m_Block.get() + offset;
+        }
+        return allocateOverflow(bytes, alignment);
+    }
+
+    void Reset() {
+        m_LastFrameBytes = m_Used + m_OverflowBytes;
+        if (!m_Overflow.empty()) {
+            m_Capacity = std::max(2 * m_Capacity, m_LastFrameBytes);
+            m_Block.reset(new unsigned char[m_Capacity]);
+            m_Overflow.clear();
+            m_Grows++;
+        }
+        m_Used = 0;
+        m_OverflowBytes = 0;
+        m_OverflowUsed = 0;
+        m_OverflowCapacity = 0;
+    }
+
+    // bytes handed out since the last Reset, including the overflow blocks
+    size_t Used() const { return m_Used + m_OverflowBytes; }
+    // bytes the frame before the last Reset used
+    size_t LastFrameBytes() const { return m_LastFrameBytes; }
+    size_t Capacity() const { return m_Capacity; }
+    // how often a frame did not fit and the block was replaced
+    unsigned int Grows() const { return m_Grows; }
+
+private:
+    std::unique_ptr<unsigned char[]> m_Block;
+    size_t m_Capacity;
+    size_t m_Used = 0;
+    std::vector<std::unique_ptr<unsigned char[]>> m_Overflow;
+    size_t m_OverflowBytes = 0;
+    size_t m_OverflowUsed = 0;
+    size_t m_OverflowCapacity = 0;
+    size_t m_LastFrameBytes = 0;
+    unsigned int m_Grows = 0;
+
+    static size_t align(size_t offset, size_t alignment) { return (offset + alignment - 1) & ~(alignment - 1); }
+
+    void* allocateOverflow(size_t bytes, size_t alignment) {
+        size_t offset = m_Overflow.empty() ? 0 : align(m_OverflowUsed, alignment);
+        if (m_Overflow.empty() || offset + bytes > m_OverflowCapacity) {
+            // new[] aligns to max_align_t like the main block
+            m_OverflowCapacity = std::max(m_Capacity, bytes);
+            m_Overflow.emplace_back(new unsigned char[m_OverflowCapacity]);
+            offset = 0;
+        }
+        m_OverflowUsed = offset + bytes;
+        m_OverflowBytes += bytes;
+        return m_Overflow.back().get() + offset;
+    }
+};
+
+// STL allocator handing out FrameArena memory, or heap memory when it has no arena. Containers
+// using an arena must be emptied or dropped before the arena is reset.
+template<typename T>
+class FrameAllocator {
+public:
+    typedef T value_type;
+    typedef std::true_type propagate_on_container_copy_assignment;
+    typedef std::true_type propagate_on_container_move_assignment;
+    typedef std::true_type propagate_on_container_swap;
+
+    FrameAllocator(FrameArena* arena = nullptr) : m_Arena(arena) {}
+    template<typename U>
+    FrameAllocator(const FrameAllocator<U>& other) : m_Arena(other.Arena()) {}
+
+    T* allocate(size_t count) {
+        if (m_Arena != nullptr)
+            return static_cast<T*>(m_Arena->Allocate(count * sizeof(T), alignof(T)));
+        return static_cast<T*>(::operator new(count * sizeof(T)));
+    }
+
+    // arena memory is released by FrameArena::Reset
+    void deallocate(T* pointer, size_t) {
+        if (m_Arena == nullptr)
+            ::operator delete(pointer);
+    }
+
+    FrameArena* Arena() const { return m_Arena; }
+
+    template<typename U>
+    bool operator==(const FrameAllocator<U>& other) const { return m_Arena == other.Arena(); }
+    template<typename U>
+    bool operator!=(const FrameAllocator<U>& other) const { return m_Arena != other.Arena(); }
+
+private:
+    FrameArena* m_Arena;
+};
+
+template<typename T>
+using FrameVector = std::vector<T, FrameAllocator<T>>;
+
+#endif //PROJECT_BASE_FRAMEARENA_H
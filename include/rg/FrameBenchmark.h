@@ -0,0 +1,124 @@
+#ifndef PROJECT_BASE_FRAMEBENCHMARK_H
+#define PROJECT_BASE_FRAMEBENCHMARK_H
+
+#include <glad/glad.h>
+#include <rg/AllocationCounter.h>
+#include <rg/CpuProfiler.h>
+#include <algorithm>
+#include <chrono>
+#include <ostream>
+#include <vector>
+
+struct FrameTimeSummary {
+    double avg = 0.0;
+    double p50 = 0.0;
+    double p95 = 0.0;
+    double p99 = 0.0;
+};
+
+// nearest rank percentiles
+inline FrameTimeSummary SummarizeFrameTimes(std::vector<double> times) {
+    FrameTimeSummary summary;
+    if (times.empty())
+        return summary;
+    std::sort(times.begin(), times.end());
+    double sum = 0.0;
+    for (double time : times)
+        sum += time;
+    summary.avg = sum / times.size();
+    auto percentile = [&](double p) {
+        size_t rank = (size_t) (p / 100.0 * times.size() + 0.5);
+        return times[std::min(times.size() - 1, rank > 0 ? rank - 1 : 0)];
+    };
+    summary.p50 = percentile(50.0);
+    summary.p95 = percentile(95.0);
+    summary.p99 = percentile(99.0);
+    return summary;
+}
+
+// Measures a fixed number of frames after a warmup. CPU time is the wall time between BeginFrame
+// and EndFrame on the calling thread, GPU time the difference of two GL_TIMESTAMP queries written
+// around the frame's commands. Timestamps are read back only once all frames are done, so the
+// measurement never waits on the GPU. heap_allocations counts operator new calls in the measured
+// frames and should be 0.
+class FrameBenchmark {
+public:
+    FrameBenchmark(int frames, int warmupFrames)
+            : m_Frames(frames), m_Warmup(warmupFrames), m_Queries(2 * frames) {
+        glGenQueries(2 * frames, m_Queries.data());
+        m_CpuMs.reserve(frames);
+    }
+
+    ~FrameBenchmark() {
+        glDeleteQueries((GLsizei) m_Queries.size(), m_Queries.data());
+    }
+
+    FrameBenchmark(const FrameBenchmark&) = delete;
+    FrameBenchmark& operator=(const FrameBenchmark&) = delete;
+
+    void BeginFrame() {
+        m_Start = std::chrono::steady_clock::now();
+        m_StartAllocations = AllocationCounter::Allocations();
+        if (measuring())
+            glQueryCounter(m_Queries[2 * measured()], GL_TIMESTAMP);
+    }
+
+    void EndFrame() {
+        if (measuring()) {
+            glQueryCounter(m_Queries[2 * measured() + 1], GL_TIMESTAMP);
+            std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - m_Start;
+            m_CpuMs.push_back(elapsed.count());
+            m_Allocations += AllocationCounter::Allocations() - m_StartAllocations;
+        }
+        m_Frame++;
+    }
+
+    bool Done() const { return m_Frame >= m_Warmup + m_Frames; }
+
+    // blocks until the GPU has finished every measured frame
+    void WriteJson(std::ostream& out, const char* renderer, int width, int height) {
+        std::vector<double> gpuMs;
+        for (int i = 0; i < measured(); i++) {
+            GLuint64 begin = 0, end = 0;
+            glGetQueryObjectui64v(m_Queries[2 * i], GL_QUERY_RESULT, &begin);
+            glGetQueryObjectui64v(m_Queries[2 * i + 1], GL_QUERY_RESULT, &end);
+            gpuMs.push_back((end - begin) / 1.0e6);
+        }
+        FrameTimeSummary cpu = SummarizeFrameTimes(m_CpuMs);
+        FrameTimeSummary gpu = SummarizeFrameTimes(gpuMs);
+        out << "{\n"
+            << "  \"renderer\": \"" << JsonEscape(renderer != nullptr ? renderer : "") << "\",\n"
+            << "  \"width\": " << width << ",\n"
+            << "  \"height\": " << height << ",\n"
+            << "  \"frames\": " << measured() << ",\n"
+            << "  \"warmup_frames\": " << m_Warmup << ",\n"
+            << "  \"heap_allocations\": " << m_Allocations << ",\n";
+        writeSummary(out, "cpu_ms", cpu);
+        out << ",\n";
+        writeSummary(out, "gpu_ms", gpu);
+        out << "\n}\n";
+    }
+
+private:
+    int m_Frames;
+    int m_Warmup;
+    int m_Frame = 0;
+    std::vector<unsigned int> m_Queries;
+    std::vector<double> m_CpuMs;
+    std::chrono::steady_clock::time_point m_Start;
+    // operator new calls inside the measured frames, see AllocationCounter
+    unsigned long long m_StartAllocations = 0;
+    unsigned long long m_Allocations = 0;
+
+    bool measuring() const { return m_Frame >= m_Warmup && !Done(); }
+    int measured() const { return (int) m_CpuMs.size(); }
+
+    static void writeSummary(std::ostream& out, const char* name, const FrameTimeSummary& summary) {
+        out << "  \"" << name << "\": {\"avg\": " << summary.avg
+            << ", \"p50\": " << summary.p50
+            << ", \"p95\": " << summary.p95
+            << ", \"p99\": " << summary.p99 << "}";
+    }
+};
+
+#endif //PROJECT_BASE_FRAMEBENCHMARK_H
@@ -0,0 +1,52 @@
+#ifndef PROJECT_BASE_FRAMEBUFFER_H
+#define PROJECT_BASE_FRAMEBUFFER_H
+
+#include <glad/glad.h>
+#include <rg/Error.h>
+
+// Offscreen render target: a color and a depth/stencil renderbuffer, multisampled when samples > 0.
+class Framebuffer {
+public:
+    Framebuffer(int width, int height, int samples = 0)
+            : m_Width(width), m_Height(height) {
+        glGenFramebuffers(1, &m_Id);
+        glGenRenderbuffers(2, m_Renderbuffers);
+        glBindFramebuffer(GL_FRAMEBUFFER, m_Id);
+
+        glBindRenderbuffer(GL_RENDERBUFFER, m_Renderbuffers[0]);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, m_Renderbuffers[0]);
+
+        glBindRenderbuffer(GL_RENDERBUFFER, m_Renderbuffers[1]);
+        glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH24_STENCIL8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, m_Renderbuffers[1]);
+
+        ASSERT(glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE, "Offscreen framebuffer is incomplete");
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    }
+
+    ~Framebuffer() {
+        glDeleteRenderbuffers(2, m_Renderbuffers);
+        glDeleteFramebuffers(1, &m_Id);
+    }
+
+    Framebuffer(const Framebuffer&) = delete;
+    Framebuffer& operator=(const Framebuffer&) = delete;
+
+    void Bind() const {
+        glBindFramebuffer(GL_FRAMEBUFFER, m_Id);
+        glViewport(0, 0, m_Width, m_Height);
+    }
+
+    int Width() const { return m_Width; }
+    int Height() const { return m_Height; }
+
+private:
+    unsigned int m_Id = 0;
+    unsigned int m_Renderbuffers[2] = {};
+    int m_Width;
+    int m_Height;
+};
+
+#endif //PROJECT_BASE_FRAMEBUFFER_H
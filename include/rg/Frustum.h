@@ -0,0 +1,82 @@
+#ifndef PROJECT_BASE_FRUSTUM_H
+#define PROJECT_BASE_FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+struct Plane {
+    glm::vec3 normal = glm::vec3(0.0f);
+    float distance = 0.0f;
+
+    float SignedDistance(const glm::vec3& point) const {
+        return glm::dot(normal, point) + distance;
+    }
+};
+
+// View frustum as six inward facing planes, extracted from a projection * view matrix.
+class Frustum {
+public:
+    enum { Left = 0, Right, Bottom, Top, Near, Far, PlaneCount };
+    Plane planes[PlaneCount];
+
+    Frustum() = default;
+
+    explicit Frustum(const glm::mat4& viewProjection) {
+        // glm is column major, row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+        const glm::mat4& m = viewProjection;
+        for (int i = 0; i < 3; i++) {
+            glm::vec4 row = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+            glm::vec4 w = glm::vec4(m[0][3], m[1][3], m[2][3], m[3][3]);
+            setPlane(2 * i, w + row);
+            setPlane(2 * i + 1, w - row);
+        }
+    }
+
+    bool IntersectsAABB(const glm::vec3& min, const glm::vec3& max) const {
+        for (const Plane& plane : planes) {
+            // the corner furthest along the plane normal
+            glm::vec3 positive(plane.normal.x >= 0.0f ? max.x : min.x,
+                               plane.normal.y >= 0.0f ? max.y : min.y,
+                               plane.normal.z >= 0.0f ? max.z : min.z);
+            if (plane.SignedDistance(positive) < 0.0f)
+                return false;
+        }
+        return true;
+    }
+
+    bool IntersectsSphere(const glm::vec3& center, float radius) const {
+        for (const Plane& plane : planes) {
+            if (plane.SignedDistance(center) < -radius)
+                return false;
+        }
+        return true;
+    }
+
+private:
+    void setPlane(int index, const glm::vec4& coefficients) {
+        glm::vec3 normal = glm::vec3(coefficients);
+        float length = glm::length(normal);
+        planes[index].normal = normal / length;
+        planes[index].distance = coefficients.w / length;
+    }
+};
+
+// box around a local space AABB after transformation by a matrix, from the transformed center and
+// the extents projected on each world axis
+inline void TransformAABB(const glm::mat4& transform, const glm::vec3& min, const glm::vec3& max,
+                          glm::vec3& outMin, glm::vec3& outMax) {
+    glm::vec3 center = glm::vec3(transform * glm::vec4(0.5f * (min + max), 1.0f));
+    glm::vec3 extents = 0.5f * (max - min);
+    glm::vec3 worldExtents(0.0f);
+    for (int axis = 0; axis < 3; axis++)
+        worldExtents += glm::abs(glm::vec3(transform[axis])) * extents[axis];
+    outMin = center - worldExtents;
+    outMax = center + worldExtents;
+}
+
+// distance from a point to the closest point of a box, 0 when inside
+inline float DistanceToAABB(const glm::vec3& point, const glm::vec3& min, const glm::vec3& max) {
+    glm::vec3 closest = glm::max(min, glm::min(point, max));
+    return glm::length(point - closest);
+}
+
+#endif //PROJECT_BASE_FRUSTUM_H
@@ -0,0 +1,171 @@
+#ifndef PROJECT_BASE_GLSTATE_H
+#define PROJECT_BASE_GLSTATE_H
+
+#include <glad/glad.h>
+#include <cstring>
+
+// counts of the state changes requested during one frame
+struct GLStateStats {
+    unsigned int issued = 0;   // reached the driver
+    unsigned int filtered = 0; // already in that state, skipped
+};
+
+// Shadow copy of the GL state the renderer touches every frame: bound program, VAO, textures per
+// unit, the cull/depth/blend switches and their parameters. Calls that would not change anything
+// are dropped before they reach the driver.
+//
+// Anything that changes this state behind the tracker's back (asset loading, ImGui) has to be
+// followed by Invalidate, which forgets the shadow copy so the next call of each kind goes through.
+class GLState {
+public:
+    static const int TextureUnits = 16;
+
+    static GLState& Get() {
+        static GLState state;
+        return state;
+    }
+
+    GLState(const GLState&) = delete;
+    GLState& operator=(const GLState&) = delete;
+
+    // the loader is generated for core 3.3 only, extensions are looked up by name
+    static bool HasExtension(const char* name) {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++) {
+            const char* extension = (const char*) glGetStringi(GL_EXTENSIONS, i);
+            if (extension != nullptr && std::strcmp(extension, name) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    void UseProgram(unsigned int program) {
+        if (filter(m_Program == program))
+            return;
+        m_Program = program;
+        glUseProgram(program);
+    }
+
+    void BindVertexArray(unsigned int vao) {
+        if (filter(m_VertexArray == vao))
+            return;
+        m_VertexArray = vao;
+        glBindVertexArray(vao);
+    }
+
+    // binds a GL_TEXTURE_2D or GL_TEXTURE_CUBE_MAP texture to a unit, switching the active unit only if needed
+    void BindTexture(unsigned int unit, GLenum target, unsigned int texture) {
+        unsigned int& bound = target == GL_TEXTURE_CUBE_MAP ? m_CubeMaps[unit] : m_Textures[unit];
+        if (filter(bound == texture))
+            return;
+        activeTexture(unit);
+        bound = texture;
+        glBindTexture(target, texture);
+    }
+
+    void SetCapability(GLenum capability, bool enabled) {
+        Switch* state = capabilitySlot(capability);
+        if (state == nullptr) {
+            // not tracked, always forwarded
+            enabled ? glEnable(capability) : glDisable(capability);
+            m_Current.issued++;
+            return;
+        }
+        if (filter(*state == (enabled ? Switch::On : Switch::Off)))
+            return;
+        *state = enabled ? Switch::On : Switch::Off;
+        enabled ? glEnable(capability) : glDisable(capability);
+    }
+
+    void Enable(GLenum capability) { SetCapability(capability, true); }
+    void Disable(GLenum capability) { SetCapability(capability, false); }
+
+    void CullFace(GLenum face) {
+        if (filter(m_CullFace == face))
+            return;
+        m_CullFace = face;
+        glCullFace(face);
+    }
+
+    void DepthFunc(GLenum func) {
+        if (filter(m_DepthFunc == func))
+            return;
+        m_DepthFunc = func;
+        glDepthFunc(func);
+    }
+
+    void BlendFunc(GLenum source, GLenum destination) {
+        if (filter(m_BlendSource == source && m_BlendDestination == destination))
+            return;
+        m_BlendSource = source;
+        m_BlendDestination = destination;
+        glBlendFunc(source, destination);
+    }
+
+    // forgets everything, the next call of every kind reaches the driver
+    void Invalidate() {
+        m_Program = Unknown;
+        m_VertexArray = Unknown;
+        m_ActiveUnit = Unknown;
+        for (int i = 0; i < TextureUnits; i++)
+            m_Textures[i] = m_CubeMaps[i] = Unknown;
+        m_CullFaceEnabled = m_DepthTest = m_Blend = m_Multisample = m_RasterizerDiscard = Switch::Unknown;
+        m_CullFace = m_DepthFunc = m_BlendSource = m_BlendDestination = Unknown;
+    }
+
+    // closes the counters of the frame that just ended
+    void EndFrame() {
+        m_LastFrame = m_Current;
+        m_Current = GLStateStats();
+    }
+
+    const GLStateStats& LastFrameStats() const { return m_LastFrame; }
+
+private:
+    enum class Switch { Unknown, Off, On };
+    static const unsigned int Unknown = 0xffffffffu;
+
+    unsigned int m_Program;
+    unsigned int m_VertexArray;
+    unsigned int m_ActiveUnit;
+    unsigned int m_Textures[TextureUnits];
+    unsigned int m_CubeMaps[TextureUnits];
+    Switch m_CullFaceEnabled, m_DepthTest, m_Blend, m_Multisample, m_RasterizerDiscard;
+    GLenum m_CullFace, m_DepthFunc, m_BlendSource, m_BlendDestination;
+    GLStateStats m_Current;
+    GLStateStats m_LastFrame;
+
+    GLState() {
+        Invalidate();
+    }
+
+    // counts the request, returns true when it can be skipped
+    bool filter(bool redundant) {
+        if (redundant)
+            m_Current.filtered++;
+        else
+            m_Current.issued++;
+        return redundant;
+    }
+
+    void activeTexture(unsigned int unit) {
+        if (filter(m_ActiveUnit == unit))
+            return;
+        m_ActiveUnit = unit;
+        glActiveTexture(GL_TEXTURE0 + unit);
+    }
+
+    Switch* capabilitySlot(GLenum capability) {
+        switch (capability) {
+            case GL_CULL_FACE: return &m_CullFaceEnabled;
+            case GL_DEPTH_TEST: return &m_DepthTest;
+            case GL_BLEND: return &m_Blend;
+            case GL_MULTISAMPLE: return &m_Multisample;
+            case GL_RASTERIZER_DISCARD: return &m_RasterizerDiscard;
+            default: return nullptr;
+        }
+    }
+};
+
+#endif //PROJECT_BASE_GLSTATE_H
@@ -0,0 +1,242 @@
+#ifndef PROJECT_BASE_GPUPROFILER_H
+#define PROJECT_BASE_GPUPROFILER_H
+
+#include <glad/glad.h>
+#include <rg/GLState.h>
+#include <algorithm>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// ARB_pipeline_statistics_query (core in 4.6), not part of the 3.3 loader
+#ifndef GL_VERTICES_SUBMITTED_ARB
+#define GL_VERTICES_SUBMITTED_ARB 0x82EE
+#define GL_PRIMITIVES_SUBMITTED_ARB 0x82EF
+#define GL_VERTEX_SHADER_INVOCATIONS_ARB 0x82F0
+#define GL_FRAGMENT_SHADER_INVOCATIONS_ARB 0x82F4
+#define GL_CLIPPING_INPUT_PRIMITIVES_ARB 0x82F6
+#define GL_CLIPPING_OUTPUT_PRIMITIVES_ARB 0x82F7
+#endif
+
+enum PipelineStatistic {
+    STAT_VERTICES_SUBMITTED = 0,
+    STAT_PRIMITIVES_SUBMITTED,
+    STAT_VERTEX_SHADER_INVOCATIONS,
+    STAT_FRAGMENT_SHADER_INVOCATIONS,
+    STAT_CLIPPING_INPUT_PRIMITIVES,
+    STAT_CLIPPING_OUTPUT_PRIMITIVES,
+    STAT_COUNT
+};
+
+inline const char* PipelineStatisticName(int statistic) {
+    static const char* names[STAT_COUNT] = {"vertices", "primitives", "vs_invocations", "fs_invocations",
+                                            "clip_in", "clip_out"};
+    return names[statistic];
+}
+
+// results of one section for one frame
+struct GpuSectionSample {
+    double ms = 0.0;
+    GLuint64 statistics[STAT_COUNT] = {};
+};
+
+// GPU time and pipeline statistics of named sections of the frame. A section may be entered several
+// times per frame, its queries are summed. Query objects are double buffered by frame: the results
+// of frame N are read while frame N + 1 is being recorded, after checking they are available, so
+// the CPU never waits on the GPU. A frame whose results are late is dropped rather than waited for.
+class GpuProfiler {
+public:
+    static const int Buffers = 2;
+    static const int HistoryLength = 240;
+
+    GpuProfiler() {
+        m_StatisticsSupported = GLState::HasExtension("GL_ARB_pipeline_statistics_query");
+    }
+
+    ~GpuProfiler() {
+        for (Frame& frame : m_Frames) {
+            for (Scope& scope : frame.scopes)
+                glDeleteQueries(1 + STAT_COUNT, scope.queries);
+        }
+    }
+
+    GpuProfiler(const GpuProfiler&) = delete;
+    GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+    bool Enabled = true;
+
+    int AddSection(const std::string& name) {
+        m_Sections.push_back(Section());
+        m_Sections.back().name = name;
+        m_Rows.reserve(HistoryLength * m_Sections.size());
+        return (int) m_Sections.size() - 1;
+    }
+
+    void BeginFrame() {
+        m_Current = (m_Current + 1) % Buffers;
+        Frame& frame = m_Frames[m_Current];
+        if (frame.used > 0)
+            collect(frame);
+        frame.used = 0;
+        m_Open = -1;
+    }
+
+    // closes the open section, if any, and opens the given one
+    void Begin(int section) {
+        if (!Enabled || section == m_Open)
+            return;
+        End();
+        Frame& frame = m_Frames[m_Current];
+        if (frame.used == frame.scopes.size()) {
+            frame.scopes.push_back(Scope());
+            glGenQueries(1 + STAT_COUNT, frame.scopes.back().queries);
+        }
+        Scope& scope = frame.scopes[frame.used++];
+        scope.section = section;
+        glBeginQuery(GL_TIME_ELAPSED, scope.queries[0]);
+        if (m_StatisticsSupported) {
+            for (int s = 0; s < STAT_COUNT; s++)
+                glBeginQuery(statisticTarget(s), scope.queries[1 + s]);
+        }
+        m_Open = section;
+    }
+
+    void End() {
+        if (m_Open < 0)
+            return;
+        glEndQuery(GL_TIME_ELAPSED);
+        if (m_StatisticsSupported) {
+            for (int s = 0; s < STAT_COUNT; s++)
+                glEndQuery(statisticTarget(s));
+        }
+        m_Open = -1;
+    }
+
+    bool StatisticsSupported() const { return m_StatisticsSupported; }
+    int SectionCount() const { return (int) m_Sections.size(); }
+    const std::string& SectionName(int section) const { return m_Sections[section].name; }
+    // the latest frame with results, one sample per section
+    const GpuSectionSample& Latest(int section) const { return m_Sections[section].latest; }
+    // milliseconds of the last HistoryLength frames, oldest first
+    const std::vector<float>& History(int section) const { return m_Sections[section].history; }
+    unsigned int DroppedFrames() const { return m_Dropped; }
+
+    // one row per frame and section of the kept history
+    bool ExportCsv(const std::string& path) const {
+        std::ofstream out(path);
+        if (!out)
+            return false;
+        out << "frame,section,gpu_ms";
+        for (int s = 0; s < STAT_COUNT; s++)
+            out << ',' << PipelineStatisticName(s);
+        out << '\n';
+        for (size_t i = 0; i < m_Rows.size(); i++) {
+            const Row& row = m_Rows[(m_RowStart + i) % m_Rows.size()];
+            out << row.frame << ',' << m_Sections[row.section].name << ',' << row.sample.ms;
+            for (int s = 0; s < STAT_COUNT; s++)
+                out << ',' << row.sample.statistics[s];
+            out << '\n';
+        }
+        return (bool) out;
+    }
+
+private:
+    struct Section {
+        std::string name;
+        GpuSectionSample latest;
+        std::vector<float> history = std::vector<float>(HistoryLength, 0.0f);
+        // the frame being collected
+        GpuSectionSample collected;
+        bool seen = false;
+    };
+
+    struct Scope {
+        int section = -1;
+        unsigned int queries[1 + STAT_COUNT] = {};
+    };
+
+    struct Frame {
+        std::vector<Scope> scopes;
+        size_t used = 0;
+    };
+
+    struct Row {
+        unsigned long long frame;
+        int section;
+        GpuSectionSample sample;
+    };
+
+    std::vector<Section> m_Sections;
+    Frame m_Frames[Buffers];
+    int m_Current = 0;
+    int m_Open = -1;
+    bool m_StatisticsSupported = false;
+    unsigned int m_Dropped = 0;
+    unsigned long long m_FrameNumber = 0;
+    // ring of the last HistoryLength rows per section, oldest at m_RowStart once it is full
+    std::vector<Row> m_Rows;
+    size_t m_RowStart = 0;
+
+    static GLenum statisticTarget(int statistic) {
+        static const GLenum targets[STAT_COUNT] = {GL_VERTICES_SUBMITTED_ARB, GL_PRIMITIVES_SUBMITTED_ARB,
+                                                   GL_VERTEX_SHADER_INVOCATIONS_ARB, GL_FRAGMENT_SHADER_INVOCATIONS_ARB,
+                                                   GL_CLIPPING_INPUT_PRIMITIVES_ARB, GL_CLIPPING_OUTPUT_PRIMITIVES_ARB};
+        return targets[statistic];
+    }
+
+    void collect(Frame& frame) {
+        // queries complete in order, if the last one is ready all of them are
+        GLuint available = 0;
+        const Scope& last = frame.scopes[frame.used - 1];
+        glGetQueryObjectuiv(last.queries[m_StatisticsSupported ? STAT_COUNT : 0], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) {
+            m_Dropped++;
+            return;
+        }
+
+        for (Section& section : m_Sections) {
+            section.collected = GpuSectionSample();
+            section.seen = false;
+        }
+        for (size_t i = 0; i < frame.used; i++) {
+            const Scope& scope = frame.scopes[i];
+            GpuSectionSample& sample = m_Sections[scope.section].collected;
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(scope.queries[0], GL_QUERY_RESULT, &elapsed);
+            sample.ms += elapsed / 1.0e6;
+            if (m_StatisticsSupported) {
+                for (int s = 0; s < STAT_COUNT; s++) {
+                    GLuint64 value = 0;
+                    glGetQueryObjectui64v(scope.queries[1 + s], GL_QUERY_RESULT, &value);
+                    sample.statistics[s] += value;
+                }
+            }
+            m_Sections[scope.section].seen = true;
+        }
+
+        m_FrameNumber++;
+        for (size_t s = 0; s < m_Sections.size(); s++) {
+            Section& section = m_Sections[s];
+            section.latest = section.collected;
+            section.history.erase(section.history.begin());
+            section.history.push_back((float) section.collected.ms);
+            if (section.seen)
+                addRow(Row{m_FrameNumber, (int) s, section.collected});
+        }
+    }
+
+    // overwrites the oldest row once the ring is full, so a steady frame does not allocate
+    void addRow(const Row& row) {
+        if (m_Rows.size() < HistoryLength * m_Sections.size()) {
+            // a section added after the ring wrapped, put the rows back in order before growing
+            std::rotate(m_Rows.begin(), m_Rows.begin() + m_RowStart, m_Rows.end());
+            m_RowStart = 0;
+            m_Rows.push_back(row);
+            return;
+        }
+        m_Rows[m_RowStart] = row;
+        m_RowStart = (m_RowStart + 1) % m_Rows.size();
+    }
+};
+
+#endif //PROJECT_BASE_GPUPROFILER_H
@@ -0,0 +1,74 @@
+#ifndef PROJECT_BASE_GRASSBENCHMARK_H
+#define PROJECT_BASE_GRASSBENCHMARK_H
+
+#include <rg/GrassField.h>
+#include <iostream>
+#include <vector>
+
+struct GrassBenchmarkResult {
+    int mode;
+    int tuftsPerSide;
+    float frameMs;
+    float grassCpuMs;
+};
+
+// Runs the render loop through every culling mode at 100k and 1M tufts and averages the
+// frame time and the CPU time spent submitting the grass for each configuration. The mode and
+// field size the user had are given back by Restore once the last configuration is measured.
+class GrassBenchmark {
+public:
+    static const int WarmupFrames = 30;
+    static const int MeasuredFrames = 120;
+
+    void Start(int mode, int tuftsPerSide) {
+        m_SavedMode = mode;
+        m_SavedTuftsPerSide = tuftsPerSide;
+        m_Configurations.clear();
+        for (int tuftsPerSide : {317, 1000})
+            for (int mode : {GRASS_MODE_CPU_CULLED, GRASS_MODE_GPU_CULLED})
+                m_Configurations.push_back({mode, tuftsPerSide, 0.0f, 0.0f});
+        m_Results.clear();
+        m_Frame = 0;
+    }
+
+    bool Running() const { return m_Results.size() < m_Configurations.size(); }
+
+    // sets the configuration that the coming frame should render
+    void Apply(int& mode, int& tuftsPerSide) const {
+        const GrassBenchmarkResult& current = m_Configurations[m_Results.size()];
+        mode = current.mode;
+        tuftsPerSide = current.tuftsPerSide;
+    }
+
+    // sets the configuration from before Start
+    void Restore(int& mode, int& tuftsPerSide) const {
+        mode = m_SavedMode;
+        tuftsPerSide = m_SavedTuftsPerSide;
+    }
+
+    void Record(float frameMs, float grassCpuMs) {
+        GrassBenchmarkResult& current = m_Configurations[m_Results.size()];
+        if (m_Frame++ >= WarmupFrames) {
+            current.frameMs += frameMs / MeasuredFrames;
+            current.grassCpuMs += grassCpuMs / MeasuredFrames;
+        }
+        if (m_Frame == WarmupFrames + MeasuredFrames) {
+            m_Results.push_back(current);
+            m_Frame = 0;
+            std::cout << "grass benchmark: " << (current.mode == GRASS_MODE_GPU_CULLED ? "gpu" : "cpu")
+                      << " culling, " << current.tuftsPerSide * current.tuftsPerSide << " tufts, frame "
+                      << current.frameMs << " ms, grass cpu " << current.grassCpuMs << " ms" << std::endl;
+        }
+    }
+
+    const std::vector<GrassBenchmarkResult>& Results() const { return m_Results; }
+
+private:
+    std::vector<GrassBenchmarkResult> m_Configurations;
+    std::vector<GrassBenchmarkResult> m_Results;
+    int m_Frame = 0;
+    int m_SavedMode = GRASS_MODE_CPU_CULLED;
+    int m_SavedTuftsPerSide = 0;
+};
+
+#endif //PROJECT_BASE_GRASSBENCHMARK_H
@@ -0,0 +1,325 @@
+#ifndef PROJECT_BASE_GRASSFIELD_H
+#define PROJECT_BASE_GRASSFIELD_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <rg/Frustum.h>
+#include <rg/BatchCuller.h>
+#include <rg/JobSystem.h>
+#include <rg/GLState.h>
+#include <rg/CpuProfiler.h>
+#include <vector>
+
+enum GrassLod {
+    GRASS_LOD_TUFT = 0,     // full tuft of three quads
+    GRASS_LOD_CROSS,        // a single crossed quad
+    GRASS_LOD_STRIP,        // a grid of long textured strips per chunk
+    GRASS_LOD_COUNT
+};
+
+// how the render loop submits the grass
+enum GrassMode {
+    GRASS_MODE_PER_QUAD = 0,    // reference path, one draw call per quad
+    GRASS_MODE_CPU_CULLED,      // chunks culled and LOD picked on the CPU
+    GRASS_MODE_GPU_CULLED,      // every tuft culled on the GPU with transform feedback
+    GRASS_MODE_COUNT
+};
+
+struct GrassChunk {
+    glm::vec3 min;
+    glm::vec3 max;
+    glm::vec3 origin;
+    unsigned int firstInstance;
+    unsigned int instanceCount;
+    unsigned int VAO;
+};
+
+struct GrassStats {
+    unsigned int chunksCulled = 0;
+    unsigned int chunksPerLod[GRASS_LOD_COUNT] = {};
+    unsigned int drawCalls = 0;
+    unsigned long long vertices = 0;
+};
+
+// The grass field split into square chunks. Tuft offsets are stored chunk by chunk in one
+// static instance buffer and every chunk has a VAO pointing at its own range, so a chunk is
+// a single instanced draw. Chunks outside the frustum are skipped, all tested at once by the
+// batch culler, and the rest pick a mesh by their distance to the camera.
+class GrassField {
+public:
+    // layout of a source vertex: position(3) normal(3) texture(2)
+    static const int FloatsPerVertex = 8;
+    static const int BladesPerTuft = 3;
+
+    bool CullingEnabled = true;
+    bool LodEnabled = true;
+    // chunks closer than LodDistances[0] draw full tufts, closer than LodDistances[1] crossed quads
+    float LodDistances[2] = {15.0f, 35.0f};
+    // distance between neighbouring strips of the far level
+    float StripSpacing = 1.0f;
+    // when set, Build fills the chunks in parallel
+    JobSystem* Jobs = nullptr;
+
+    GrassField(const float* quadVertices, unsigned int quadVertexCount)
+            : m_Quad(quadVertices, quadVertices + quadVertexCount * FloatsPerVertex)
+            , m_QuadVertexCount(quadVertexCount) {
+        glGenBuffers(1, &m_MeshVBO);
+        glGenBuffers(1, &m_InstanceVBO);
+        glGenBuffers(1, &m_StripInstanceVBO);
+    }
+
+    ~GrassField() {
+        releaseChunks();
+        glDeleteVertexArrays(1, &m_StripVAO);
+        glDeleteBuffers(1, &m_MeshVBO);
+        glDeleteBuffers(1, &m_InstanceVBO);
+        glDeleteBuffers(1, &m_StripInstanceVBO);
+    }
+
+    GrassField(const GrassField&) = delete;
+    GrassField& operator=(const GrassField&) = delete;
+
+    // fills a square field of tuftsPerSide x tuftsPerSide tufts covering [-extent / 2, extent / 2),
+    // split into chunksPerSide x chunksPerSide chunks, and uploads it once into static buffers
+    void Build(int tuftsPerSide, float extent = 100.0f, float height = 0.3f, int chunksPerSide = 10) {
+        RG_PROFILE_FUNCTION();
+        releaseChunks();
+        float spacing = extent / tuftsPerSide;
+        float chunkSize = extent / chunksPerSide;
+        buildMeshes(chunkSize);
+
+        // first tuft row/column of every chunk row/column
+        std::vector<int> start(chunksPerSide + 1);
+        for (int c = 0; c <= chunksPerSide; c++)
+            start[c] = (c * tuftsPerSide + chunksPerSide - 1) / chunksPerSide;
+
+        // every chunk's range in the instance buffer is known up front, so chunks fill independently
+        m_Chunks.resize((size_t) chunksPerSide * chunksPerSide);
+        unsigned int instances = 0;
+        for (int cx = 0; cx < chunksPerSide; cx++) {
+            for (int cz = 0; cz < chunksPerSide; cz++) {
+                GrassChunk& chunk = m_Chunks[cx * chunksPerSide + cz];
+                chunk.firstInstance = instances;
+                chunk.instanceCount = (start[cx + 1] - start[cx]) * (start[cz + 1] - start[cz]);
+                instances += chunk.instanceCount;
+            }
+        }
+        m_Positions.resize(instances);
+
+        auto fillChunks = [&](size_t first, size_t last) {
+            for (size_t c = first; c < last; c++) {
+                int cx = (int) c / chunksPerSide;
+                int cz = (int) c % chunksPerSide;
+                GrassChunk& chunk = m_Chunks[c];
+                chunk.origin = glm::vec3(cx * chunkSize - extent / 2.0f, height, cz * chunkSize - extent / 2.0f);
+                chunk.min = chunk.origin + m_Bounds[0];
+                chunk.max = chunk.origin + glm::vec3(chunkSize, 0.0f, chunkSize) + m_Bounds[1];
+                unsigned int instance = chunk.firstInstance;
+                for (int i = start[cx]; i < start[cx + 1]; i++) {
+                    for (int j = start[cz]; j < start[cz + 1]; j++) {
+                        glm::vec3 position = glm::vec3(i * spacing - extent / 2.0f, height, j * spacing - extent / 2.0f);
+                        chunk.min = glm::min(chunk.min, position + m_Bounds[0]);
+                        chunk.max = glm::max(chunk.max, position + m_Bounds[1]);
+                        m_Positions[instance++] = position;
+                    }
+                }
+            }
+        };
+        if (Jobs != nullptr)
+            Jobs->ParallelFor(0, m_Chunks.size(), 1, fillChunks);
+        else
+            fillChunks(0, m_Chunks.size());
+        for (const GrassChunk& chunk : m_Chunks)
+            m_ChunkBounds.Add(chunk.min, chunk.max);
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_InstanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, m_Positions.size() * sizeof(glm::vec3), m_Positions.data(), GL_STATIC_DRAW);
+        for (GrassChunk& chunk : m_Chunks)
+            chunk.VAO = CreateInstancedVAO(m_InstanceVBO, chunk.firstInstance * sizeof(glm::vec3));
+        glDeleteVertexArrays(1, &m_StripVAO);
+        m_StripVAO = CreateInstancedVAO(m_StripInstanceVBO, 0);
+        m_StripOrigins.reserve(m_Chunks.size());
+        m_TuftsPerSide = tuftsPerSide;
+    }
+
+    // expects grassShaderInstanced to be in use
+    void Draw(const Frustum& frustum, const glm::vec3& cameraPosition) {
+        m_Stats = GrassStats();
+        m_StripOrigins.clear();
+        if (CullingEnabled) {
+            CullBounds(frustum, m_ChunkBounds, m_VisibleChunks);
+        } else {
+            m_VisibleChunks.resize(m_Chunks.size());
+            for (size_t i = 0; i < m_Chunks.size(); i++)
+                m_VisibleChunks[i] = (unsigned int) i;
+        }
+        m_Stats.chunksCulled = (unsigned int) (m_Chunks.size() - m_VisibleChunks.size());
+
+        for (unsigned int index : m_VisibleChunks) {
+            const GrassChunk& chunk = m_Chunks[index];
+            int lod = GRASS_LOD_TUFT;
+            if (LodEnabled) {
+                float distance = DistanceToAABB(cameraPosition, chunk.min, chunk.max);
+                if (distance >= LodDistances[1])
+                    lod = GRASS_LOD_STRIP;
+                else if (distance >= LodDistances[0])
+                    lod = GRASS_LOD_CROSS;
+            }
+            m_Stats.chunksPerLod[lod]++;
+            if (chunk.instanceCount == 0)
+                continue;
+            if (lod == GRASS_LOD_STRIP) {
+                m_StripOrigins.push_back(chunk.origin);
+                continue;
+            }
+            GLState::Get().BindVertexArray(chunk.VAO);
+            glDrawArraysInstanced(GL_TRIANGLES, m_LodFirst[lod], m_LodCount[lod], chunk.instanceCount);
+            m_Stats.drawCalls++;
+            m_Stats.vertices += (unsigned long long) m_LodCount[lod] * chunk.instanceCount;
+        }
+
+        // all far chunks share one strip grid mesh, one instance per chunk
+        if (!m_StripOrigins.empty()) {
+            glBindBuffer(GL_ARRAY_BUFFER, m_StripInstanceVBO);
+            glBufferData(GL_ARRAY_BUFFER, m_StripOrigins.size() * sizeof(glm::vec3), m_StripOrigins.data(), GL_STREAM_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, 0);
+            GLState::Get().BindVertexArray(m_StripVAO);
+            glDrawArraysInstanced(GL_TRIANGLES, m_LodFirst[GRASS_LOD_STRIP], m_LodCount[GRASS_LOD_STRIP], (GLsizei) m_StripOrigins.size());
+            m_Stats.drawCalls++;
+            m_Stats.vertices += (unsigned long long) m_LodCount[GRASS_LOD_STRIP] * m_StripOrigins.size();
+        }
+    }
+
+    const std::vector<glm::vec3>& Positions() const { return m_Positions; }
+    const std::vector<GrassChunk>& Chunks() const { return m_Chunks; }
+    const GrassStats& Stats() const { return m_Stats; }
+    int TuftsPerSide() const { return m_TuftsPerSide; }
+    unsigned int TuftCount() const { return (unsigned int) m_Positions.size(); }
+    unsigned int LodFirstVertex(int lod) const { return m_LodFirst[lod]; }
+    unsigned int LodVertexCount(int lod) const { return m_LodCount[lod]; }
+    // all tuft offsets, chunk after chunk
+    unsigned int InstanceBuffer() const { return m_InstanceVBO; }
+    const glm::vec3& TuftBoundsMin() const { return m_Bounds[0]; }
+    const glm::vec3& TuftBoundsMax() const { return m_Bounds[1]; }
+
+    // VAO drawing the field meshes with per-instance offsets read from instanceBuffer
+    unsigned int CreateInstancedVAO(unsigned int instanceBuffer, size_t instanceOffset) const {
+        unsigned int VAO;
+        glGenVertexArrays(1, &VAO);
+        GLState::Get().BindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_MeshVBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, FloatsPerVertex * sizeof(float), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, FloatsPerVertex * sizeof(float), (void*)(3 * sizeof(float)));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, FloatsPerVertex * sizeof(float), (void*)(6 * sizeof(float)));
+
+        // per-instance offset, a tuft position or a chunk origin for the strips
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)instanceOffset);
+        glVertexAttribDivisor(3, 1);
+
+        GLState::Get().BindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+        return VAO;
+    }
+
+private:
+    std::vector<float> m_Quad;
+    unsigned int m_QuadVertexCount;
+    unsigned int m_MeshVBO = 0;
+    unsigned int m_InstanceVBO = 0;
+    unsigned int m_StripInstanceVBO = 0;
+    unsigned int m_StripVAO = 0;
+    int m_TuftsPerSide = 0;
+    // all three levels live in one vertex buffer
+    unsigned int m_LodFirst[GRASS_LOD_COUNT] = {};
+    unsigned int m_LodCount[GRASS_LOD_COUNT] = {};
+    // bounds of a single tuft relative to its position
+    glm::vec3 m_Bounds[2];
+    std::vector<glm::vec3> m_Positions;
+    std::vector<GrassChunk> m_Chunks;
+    // chunk boxes for the batch culler, in chunk order
+    BoundsSoA m_ChunkBounds;
+    std::vector<unsigned int> m_VisibleChunks;
+    std::vector<glm::vec3> m_StripOrigins;
+    GrassStats m_Stats;
+
+    void buildMeshes(float chunkSize) {
+        std::vector<float> vertices;
+
+        // same rotate/scale chain the per-tuft draw loop applies, baked into the vertices
+        m_LodFirst[GRASS_LOD_TUFT] = 0;
+        glm::mat4 blade = glm::mat4(1.0f);
+        glm::mat4 firstBlade;
+        for (int j = 0; j < BladesPerTuft; j++) {
+            blade = glm::rotate(blade, glm::radians(120.0f), glm::vec3(0, 1, 0));
+            blade = glm::scale(blade, glm::vec3(1.6f, 1.0f, 1.6f));
+            if (j == 0)
+                firstBlade = blade;
+            appendQuad(vertices, blade, 1.0f);
+        }
+        m_LodCount[GRASS_LOD_TUFT] = vertexCount(vertices);
+
+        m_Bounds[0] = glm::vec3(vertices[0], vertices[1], vertices[2]);
+        m_Bounds[1] = m_Bounds[0];
+        for (size_t v = 0; v < vertices.size(); v += FloatsPerVertex) {
+            glm::vec3 position(vertices[v], vertices[v + 1], vertices[v + 2]);
+            m_Bounds[0] = glm::min(m_Bounds[0], position);
+            m_Bounds[1] = glm::max(m_Bounds[1], position);
+        }
+
+        m_LodFirst[GRASS_LOD_CROSS] = vertexCount(vertices);
+        appendQuad(vertices, firstBlade, 1.0f);
+        appendQuad(vertices, glm::rotate(firstBlade, glm::radians(90.0f), glm::vec3(0, 1, 0)), 1.0f);
+        m_LodCount[GRASS_LOD_CROSS] = vertexCount(vertices) - m_LodFirst[GRASS_LOD_CROSS];
+
+        // strips running along x and along z, in chunk space; the texture repeats once per tuft width
+        m_LodFirst[GRASS_LOD_STRIP] = vertexCount(vertices);
+        int strips = (int) glm::max(1.0f, chunkSize / StripSpacing);
+        float repeats = chunkSize / 1.6f;
+        for (int k = 0; k < strips; k++) {
+            float offset = (k + 0.5f) * chunkSize / strips;
+            glm::mat4 alongX = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, offset));
+            appendQuad(vertices, glm::scale(alongX, glm::vec3(chunkSize, 1.0f, 1.0f)), repeats);
+            glm::mat4 alongZ = glm::translate(glm::mat4(1.0f), glm::vec3(offset, 0.0f, chunkSize));
+            alongZ = glm::rotate(alongZ, glm::radians(90.0f), glm::vec3(0, 1, 0));
+            appendQuad(vertices, glm::scale(alongZ, glm::vec3(chunkSize, 1.0f, 1.0f)), repeats);
+        }
+        m_LodCount[GRASS_LOD_STRIP] = vertexCount(vertices) - m_LodFirst[GRASS_LOD_STRIP];
+
+        glBindBuffer(GL_ARRAY_BUFFER, m_MeshVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    // appends the source quad transformed by transform, with u scaled by uScale
+    void appendQuad(std::vector<float>& vertices, const glm::mat4& transform, float uScale) const {
+        glm::mat3 normalMatrix = glm::mat3(glm::transpose(glm::inverse(transform)));
+        for (unsigned int v = 0; v < m_QuadVertexCount; v++) {
+            const float* src = &m_Quad[v * FloatsPerVertex];
+            glm::vec3 position = glm::vec3(transform * glm::vec4(src[0], src[1], src[2], 1.0f));
+            glm::vec3 normal = normalMatrix * glm::vec3(src[3], src[4], src[5]);
+            float baked[FloatsPerVertex] = {position.x, position.y, position.z,
+                                            normal.x, normal.y, normal.z,
+                                            src[6] * uScale, src[7]};
+            vertices.insert(vertices.end(), baked, baked + FloatsPerVertex);
+        }
+    }
+
+    static unsigned int vertexCount(const std::vector<float>& vertices) {
+        return (unsigned int) (vertices.size() / FloatsPerVertex);
+    }
+
+    void releaseChunks() {
+        for (GrassChunk& chunk : m_Chunks)
+            glDeleteVertexArrays(1, &chunk.VAO);
+        m_Chunks.clear();
+        m_ChunkBounds.Clear();
+    }
+};
+
+#endif //PROJECT_BASE_GRASSFIELD_H
@@ -0,0 +1,198 @@
+#ifndef PROJECT_BASE_GRASSGPUCULLER_H
+#define PROJECT_BASE_GRASSGPUCULLER_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+#include <rg/Frustum.h>
+#include <rg/GrassField.h>
+#include <rg/GLState.h>
+#include <cstdint>
+
+// Culls every grass tuft on the GPU. A vertex + geometry program runs over the whole instance
+// buffer as points with rasterization disabled, and only the tufts that pass the frustum test
+// (when the field's CullingEnabled is set) and the distance test are streamed into a compacted
+// buffer through transform feedback, once for the full tuft level and once for the crossed quad
+// level. The number of survivors comes back through a GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN
+// query.
+//
+// Results go to a ring of three buffer sets. Draw only polls whether the queries of earlier passes
+// are available and draws the newest set whose counts came back, so with several frames queued
+// the CPU never waits on the GPU; the grass then lags the camera by the frames in flight. A pass
+// never writes the set being drawn, and when every other set is still in flight it replaces the
+// newest of them, so the oldest always gets to finish.
+class GrassGpuCuller {
+public:
+    static const int Levels = 2; // GRASS_LOD_TUFT and GRASS_LOD_CROSS
+    static const int Sets = 3;
+
+    // nothing further than this is drawn
+    float CullDistance = 80.0f;
+
+    explicit GrassGpuCuller(Shader& cullShader)
+            : m_CullShader(cullShader)
+            , m_PlanesLocation(cullShader.getUniformLocation("frustumPlanes"))
+            , m_CameraLocation(cullShader.getUniformLocation("cameraPosition"))
+            , m_TuftMinLocation(cullShader.getUniformLocation("tuftMin"))
+            , m_TuftMaxLocation(cullShader.getUniformLocation("tuftMax"))
+            , m_RangeLocation(cullShader.getUniformLocation("distanceRange"))
+            , m_FrustumCullingLocation(cullShader.getUniformLocation("frustumCulling")) {
+        glGenBuffers(Sets * Levels, &m_Output[0][0]);
+        glGenQueries(Sets * Levels, &m_Queries[0][0]);
+    }
+
+    ~GrassGpuCuller() {
+        releaseVAOs();
+        glDeleteBuffers(Sets * Levels, &m_Output[0][0]);
+        glDeleteQueries(Sets * Levels, &m_Queries[0][0]);
+    }
+
+    GrassGpuCuller(const GrassGpuCuller&) = delete;
+    GrassGpuCuller& operator=(const GrassGpuCuller&) = delete;
+
+    // runs the culling pass, leaves the cull program bound
+    void Cull(const GrassField& field, const Frustum& frustum, const glm::vec3& cameraPosition) {
+        if (field.TuftCount() != m_Capacity || field.InstanceBuffer() != m_Source)
+            resize(field);
+        int set = nextSet();
+
+        glm::vec4 planes[Frustum::PlaneCount];
+        for (int i = 0; i < Frustum::PlaneCount; i++)
+            planes[i] = glm::vec4(frustum.planes[i].normal, frustum.planes[i].distance);
+
+        m_CullShader.use();
+        glUniform4fv(m_PlanesLocation, Frustum::PlaneCount, &planes[0][0]);
+        m_CullShader.setVec3(m_CameraLocation, cameraPosition);
+        m_CullShader.setVec3(m_TuftMinLocation, field.TuftBoundsMin());
+        m_CullShader.setVec3(m_TuftMaxLocation, field.TuftBoundsMax());
+        m_CullShader.setBool(m_FrustumCullingLocation, field.CullingEnabled);
+
+        float lodDistance = field.LodEnabled ? field.LodDistances[0] : CullDistance;
+        glm::vec2 ranges[Levels] = {glm::vec2(0.0f, lodDistance), glm::vec2(lodDistance, CullDistance)};
+
+        GLState& state = GLState::Get();
+        state.Enable(GL_RASTERIZER_DISCARD);
+        state.BindVertexArray(m_SourceVAO);
+        for (int lod = 0; lod < Levels; lod++) {
+            m_CullShader.setVec2(m_RangeLocation, ranges[lod]);
+            glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, m_Output[set][lod]);
+            glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, m_Queries[set][lod]);
+            glBeginTransformFeedback(GL_POINTS);
+            glDrawArrays(GL_POINTS, 0, m_Capacity);
+            glEndTransformFeedback();
+            glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+        }
+        glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+        state.Disable(GL_RASTERIZER_DISCARD);
+        m_Submitted[set] = ++m_Sequence;
+    }
+
+    // draws the survivors of the newest Cull whose counts are back, nothing until the first one is.
+    // Expects grassShaderInstanced to be in use.
+    void Draw(const GrassField& field) {
+        collectFinished();
+        for (int lod = 0; lod < Levels; lod++) {
+            m_Visible[lod] = m_Drawn >= 0 ? m_Counts[m_Drawn][lod] : 0;
+            if (m_Visible[lod] == 0)
+                continue;
+            GLState::Get().BindVertexArray(m_DrawVAO[m_Drawn][lod]);
+            glDrawArraysInstanced(GL_TRIANGLES, field.LodFirstVertex(lod), field.LodVertexCount(lod), m_Visible[lod]);
+        }
+    }
+
+    unsigned int VisibleCount(int lod) const { return m_Visible[lod]; }
+
+private:
+    Shader& m_CullShader;
+    int m_PlanesLocation;
+    int m_CameraLocation;
+    int m_TuftMinLocation;
+    int m_TuftMaxLocation;
+    int m_RangeLocation;
+    int m_FrustumCullingLocation;
+    unsigned int m_Capacity = 0;
+    unsigned int m_Source = 0;
+    unsigned int m_SourceVAO = 0;
+    unsigned int m_Output[Sets][Levels] = {};
+    unsigned int m_Queries[Sets][Levels] = {};
+    unsigned int m_DrawVAO[Sets][Levels] = {};
+    // number of the Cull whose queries are still to be read from the set, 0 when none is
+    uint64_t m_Submitted[Sets] = {};
+    uint64_t m_Sequence = 0;
+    unsigned int m_Counts[Sets][Levels] = {};
+    int m_Drawn = -1;
+    unsigned int m_Visible[Levels] = {};
+
+    // a set that is neither drawn nor in flight, otherwise the newest one in flight
+    int nextSet() const {
+        int newest = -1;
+        for (int set = 0; set < Sets; set++) {
+            if (set == m_Drawn)
+                continue;
+            if (m_Submitted[set] == 0)
+                return set;
+            if (newest < 0 || m_Submitted[set] > m_Submitted[newest])
+                newest = set;
+        }
+        return newest;
+    }
+
+    // reads the counts of the passes the GPU has finished, oldest first, without waiting
+    void collectFinished() {
+        for (;;) {
+            int oldest = -1;
+            for (int set = 0; set < Sets; set++) {
+                if (m_Submitted[set] != 0 && (oldest < 0 || m_Submitted[set] < m_Submitted[oldest]))
+                    oldest = set;
+            }
+            if (oldest < 0)
+                return;
+            for (int lod = 0; lod < Levels; lod++) {
+                GLuint available = 0;
+                glGetQueryObjectuiv(m_Queries[oldest][lod], GL_QUERY_RESULT_AVAILABLE, &available);
+                if (!available)
+                    return;
+            }
+            for (int lod = 0; lod < Levels; lod++)
+                glGetQueryObjectuiv(m_Queries[oldest][lod], GL_QUERY_RESULT, &m_Counts[oldest][lod]);
+            m_Submitted[oldest] = 0;
+            m_Drawn = oldest;
+        }
+    }
+
+    void resize(const GrassField& field) {
+        releaseVAOs();
+        m_Capacity = field.TuftCount();
+        m_Source = field.InstanceBuffer();
+        for (int set = 0; set < Sets; set++)
+            m_Submitted[set] = 0;
+        m_Drawn = -1;
+
+        // the tuft offsets read once per point, without a divisor
+        glGenVertexArrays(1, &m_SourceVAO);
+        GLState::Get().BindVertexArray(m_SourceVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, m_Source);
+        glEnableVertexAttribArray(3);
+        glVertexAttribPointer(3, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        GLState::Get().BindVertexArray(0);
+
+        for (int set = 0; set < Sets; set++) {
+            for (int lod = 0; lod < Levels; lod++) {
+                glBindBuffer(GL_ARRAY_BUFFER, m_Output[set][lod]);
+                glBufferData(GL_ARRAY_BUFFER, m_Capacity * sizeof(glm::vec3), NULL, GL_DYNAMIC_COPY);
+                m_DrawVAO[set][lod] = field.CreateInstancedVAO(m_Output[set][lod], 0);
+            }
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+
+    void releaseVAOs() {
+        // a deleted name may come back from glGenVertexArrays, the tracker must not trust it
+        GLState::Get().BindVertexArray(0);
+        glDeleteVertexArrays(1, &m_SourceVAO);
+        glDeleteVertexArrays(Sets * Levels, &m_DrawVAO[0][0]);
+        m_SourceVAO = 0;
+    }
+};
+
+#endif //PROJECT_BASE_GRASSGPUCULLER_H
@@ -0,0 +1,267 @@
+#ifndef PROJECT_BASE_JOBSYSTEM_H
+#define PROJECT_BASE_JOBSYSTEM_H
+
+#include <rg/CpuProfiler.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counts the unfinished jobs of a group. Jobs submitted with a counter increment it and decrement
+// it when they finish, Wait returns once it is back to zero.
+class JobCounter {
+public:
+    bool Done() const { return m_Pending.load(std::memory_order_acquire) == 0; }
+
+private:
+    friend class JobSystem;
+    std::atomic<int> m_Pending{0};
+};
+
+// per worker figures of the last frame
+struct JobWorkerStats {
+    float utilization = 0.0f;   // busy time / frame time
+    unsigned int jobs = 0;
+    unsigned int steals = 0;
+};
+
+// Work stealing thread pool. Every thread, the workers and the thread that created the pool, owns
+// a deque: it pushes and pops its own jobs at the back, idle threads steal the oldest job from the
+// front of someone else's. A thread waiting on a counter keeps executing jobs instead of blocking,
+// so jobs may submit and wait on further jobs, which is how dependent work (a task graph) is
+// expressed: a job waits on the counter of the jobs it depends on, or submits its successors
+// when it is done.
+//
+// The creating thread is slot 0 and is meant to be the GL thread: it hands out work, helps while
+// waiting and consumes the results, but nothing it submits needs a GL context.
+class JobSystem {
+public:
+    typedef std::function<void()> Job;
+
+    // workers == 0 uses one worker per hardware thread besides the calling one
+    explicit JobSystem(unsigned int workers = 0) {
+        if (workers == 0)
+            workers = std::max(1u, std::thread::hardware_concurrency()) - 1;
+        m_Queues.resize(workers + 1);
+        for (std::unique_ptr<Queue>& queue : m_Queues)
+            queue.reset(new Queue());
+        threadIndex() = 0;
+        m_FrameStart = now();
+        for (unsigned int i = 1; i <= workers; i++)
+            m_Threads.emplace_back([this, i]() { workerLoop(i); });
+    }
+
+    ~JobSystem() {
+        {
+            std::lock_guard<std::mutex> lock(m_SleepMutex);
+            m_Quit = true;
+        }
+        m_Wake.notify_all();
+        for (std::thread& thread : m_Threads)
+            thread.join();
+    }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    // worker threads plus the calling thread
+    unsigned int ThreadCount() const { return (unsigned int) m_Queues.size(); }
+
+    void Submit(Job job, JobCounter* counter = nullptr) {
+        if (counter != nullptr)
+            counter->m_Pending.fetch_add(1, std::memory_order_relaxed);
+        Queue& queue = *m_Queues[threadIndex()];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            queue.jobs.PushBack(Entry{std::move(job), counter});
+        }
+        m_Queued.fetch_add(1, std::memory_order_release);
+        // a worker between its check and its wait holds the mutex, so it cannot miss the notify
+        { std::lock_guard<std::mutex> lock(m_SleepMutex); }
+        m_Wake.notify_one();
+    }
+
+    // runs other jobs until every job of the counter has finished
+    void Wait(const JobCounter& counter) {
+        unsigned int self = threadIndex();
+        while (!counter.Done()) {
+            if (!runOne(self))
+                std::this_thread::yield();
+        }
+    }
+
+    // Calls body(first, last) over [begin, end) split into ranges of about grain items, spread over
+    // all threads, and returns once every range is done.
+    template<typename Body>
+    void ParallelFor(size_t begin, size_t end, size_t grain, const Body& body) {
+        if (end <= begin)
+            return;
+        grain = std::max<size_t>(1, grain);
+        JobCounter counter;
+        // two words of capture fit std::function's inline storage, so the jobs do not allocate
+        struct Range {
+            const Body& body;
+            size_t end;
+            size_t grain;
+        } range{body, end, grain};
+        for (size_t first = begin; first < end; first += grain) {
+            Submit([&range, first]() { range.body(first, std::min(range.end, first + range.grain)); }, &counter);
+        }
+        Wait(counter);
+    }
+
+    // closes the utilization counters of the frame that just ended
+    void EndFrame() {
+        auto frameEnd = now();
+        double frameNs = (double) std::max<long long>(1, frameEnd - m_FrameStart);
+        m_LastFrame.resize(m_Queues.size());
+        for (size_t i = 0; i < m_Queues.size(); i++) {
+            Queue& queue = *m_Queues[i];
+            m_LastFrame[i].utilization = (float) std::min(1.0, queue.busyNs.exchange(0) / frameNs);
+            m_LastFrame[i].jobs = queue.jobsRun.exchange(0);
+            m_LastFrame[i].steals = queue.steals.exchange(0);
+        }
+        m_FrameStart = frameEnd;
+    }
+
+    // index 0 is the thread that created the pool
+    const std::vector<JobWorkerStats>& LastFrameStats() const { return m_LastFrame; }
+
+private:
+    struct Entry {
+        Job job;
+        JobCounter* counter = nullptr;
+    };
+
+    // Deque of entries in a ring that only ever grows. std::deque frees and allocates blocks as
+    // the front and back move, which a frame full of small jobs would do every frame.
+    class EntryRing {
+    public:
+        bool empty() const { return m_Count == 0; }
+
+        void PushBack(Entry&& entry) {
+            if (m_Count == m_Slots.size())
+                grow();
+            m_Slots[(m_Head + m_Count) % m_Slots.size()] = std::move(entry);
+            m_Count++;
+        }
+
+        Entry PopBack() {
+            m_Count--;
+            return take((m_Head + m_Count) % m_Slots.size());
+        }
+
+        Entry PopFront() {
+            Entry entry = take(m_Head);
+            m_Head = (m_Head + 1) % m_Slots.size();
+            m_Count--;
+            return entry;
+        }
+
+    private:
+        std::vector<Entry> m_Slots = std::vector<Entry>(64);
+        size_t m_Head = 0;
+        size_t m_Count = 0;
+
+        // leaves the slot empty, so a finished job's captures do not outlive it
+        Entry take(size_t slot) {
+            Entry entry = std::move(m_Slots[slot]);
+            m_Slots[slot] = Entry();
+            return entry;
+        }
+
+        void grow() {
+            std::vector<Entry> slots(2 * m_Slots.size());
+            for (size_t i = 0; i < m_Count; i++)
+                slots[i] = std::move(m_Slots[(m_Head + i) % m_Slots.size()]);
+            m_Slots.swap(slots);
+            m_Head = 0;
+        }
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        EntryRing jobs;
+        std::atomic<long long> busyNs{0};
+        std::atomic<unsigned int> jobsRun{0};
+        std::atomic<unsigned int> steals{0};
+    };
+
+    std::vector<std::unique_ptr<Queue>> m_Queues;
+    std::vector<std::thread> m_Threads;
+    std::atomic<int> m_Queued{0};
+    std::mutex m_SleepMutex;
+    std::condition_variable m_Wake;
+    bool m_Quit = false;
+    long long m_FrameStart;
+    std::vector<JobWorkerStats> m_LastFrame;
+
+    static unsigned int& threadIndex() {
+        thread_local unsigned int index = 0;
+        return index;
+    }
+
+    static long long now() {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    // own jobs newest first, then the oldest job of another thread
+    bool runOne(unsigned int self) {
+        Entry entry;
+        bool found = false;
+        {
+            Queue& own = *m_Queues[self];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            if (!own.jobs.empty()) {
+                entry = own.jobs.PopBack();
+                m_Queued.fetch_sub(1, std::memory_order_relaxed);
+                found = true;
+            }
+        }
+        for (size_t offset = 1; !found && offset < m_Queues.size(); offset++) {
+            Queue& victim = *m_Queues[(self + offset) % m_Queues.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.jobs.empty()) {
+                entry = victim.jobs.PopFront();
+                m_Queued.fetch_sub(1, std::memory_order_relaxed);
+                found = true;
+                m_Queues[self]->steals.fetch_add(1, std::memory_order_relaxed);
+            }
+        }
+        if (!found)
+            return false;
+
+        long long start = now();
+        {
+            RG_PROFILE_ZONE("Job");
+            entry.job();
+        }
+        Queue& own = *m_Queues[self];
+        own.busyNs.fetch_add(now() - start, std::memory_order_relaxed);
+        own.jobsRun.fetch_add(1, std::memory_order_relaxed);
+        if (entry.counter != nullptr)
+            entry.counter->m_Pending.fetch_sub(1, std::memory_order_release);
+        return true;
+    }
+
+    void workerLoop(unsigned int index) {
+        threadIndex() = index;
+        RG_PROFILE_THREAD("worker " + std::to_string(index));
+        while (true) {
+            if (runOne(index))
+                continue;
+            std::unique_lock<std::mutex> lock(m_SleepMutex);
+            m_Wake.wait(lock, [this]() { return m_Quit || m_Queued.load(std::memory_order_acquire) > 0; });
+            if (m_Quit)
+                return;
+        }
+    }
+};
+
+#endif //PROJECT_BASE_JOBSYSTEM_H
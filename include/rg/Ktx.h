@@ -0,0 +1,168 @@
+#ifndef PROJECT_BASE_KTX_H
+#define PROJECT_BASE_KTX_H
+
+#include <rg/MappedFile.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// one mip level of one face, offset into KtxTexture::data
+struct KtxImage {
+    uint32_t level;
+    uint32_t face;
+    uint32_t width;
+    uint32_t height;
+    size_t offset;
+    uint32_t size;
+};
+
+// Block compressed texture in a KTX 1.1 container. Only what the cooker writes is read back:
+// compressed formats, 2D (depth 0, no array), one or six faces, little endian.
+struct KtxTexture {
+    uint32_t internalFormat = 0;
+    uint32_t baseInternalFormat = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t faces = 1;
+    uint32_t levels = 0;
+    uint32_t sourceChannels = 0;    // "RGSourceChannels", channels of the image it was cooked from
+    std::vector<KtxImage> images;   // level major: images[level * faces + face]
+    std::vector<unsigned char> data;
+
+    const KtxImage& Image(uint32_t level, uint32_t face = 0) const { return images[level * faces + face]; }
+};
+
+namespace ktx {
+
+static const unsigned char Identifier[12] = {0xAB, 'K', 'T', 'X', ' ', '1', '1', 0xBB, '\r', '\n', 0x1A, '\n'};
+static const uint32_t Endianness = 0x04030201;
+static const char SourceChannelsKey[] = "RGSourceChannels";
+
+struct Header {
+    unsigned char identifier[12];
+    uint32_t endianness;
+    uint32_t glType;
+    uint32_t glTypeSize;
+    uint32_t glFormat;
+    uint32_t glInternalFormat;
+    uint32_t glBaseInternalFormat;
+    uint32_t pixelWidth;
+    uint32_t pixelHeight;
+    uint32_t pixelDepth;
+    uint32_t numberOfArrayElements;
+    uint32_t numberOfFaces;
+    uint32_t numberOfMipmapLevels;
+    uint32_t bytesOfKeyValueData;
+};
+
+inline size_t padded(size_t size) { return (size + 3) & ~(size_t) 3; }
+
+} // namespace ktx
+
+inline bool ReadKtx(const std::string& path, KtxTexture& texture) {
+    using namespace ktx;
+    MappedFile file;
+    if (!file.Open(path) || file.Size() < sizeof(Header))
+        return false;
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(file.Data());
+    Header header;
+    std::memcpy(&header, bytes, sizeof(header));
+    if (std::memcmp(header.identifier, Identifier, sizeof(Identifier)) != 0 || header.endianness != Endianness
+        || header.glType != 0 || header.glFormat != 0 || header.pixelDepth != 0 || header.numberOfArrayElements != 0
+        || (header.numberOfFaces != 1 && header.numberOfFaces != 6) || header.numberOfMipmapLevels == 0
+        || header.pixelWidth == 0 || header.pixelHeight == 0 || header.numberOfMipmapLevels > 32
+        || header.bytesOfKeyValueData > file.Size() - sizeof(Header))
+        return false;
+
+    texture = KtxTexture();
+    texture.internalFormat = header.glInternalFormat;
+    texture.baseInternalFormat = header.glBaseInternalFormat;
+    texture.width = header.pixelWidth;
+    texture.height = header.pixelHeight;
+    texture.faces = header.numberOfFaces;
+    texture.levels = header.numberOfMipmapLevels;
+
+    size_t offset = sizeof(Header);
+    size_t keyValueEnd = offset + header.bytesOfKeyValueData;
+    while (offset + 4 <= keyValueEnd) {
+        uint32_t length;
+        std::memcpy(&length, bytes + offset, 4);
+        offset += 4;
+        if (length > keyValueEnd - offset)
+            return false;
+        const char* pair = reinterpret_cast<const char*>(bytes + offset);
+        if (length > sizeof(SourceChannelsKey) && std::memcmp(pair, SourceChannelsKey, sizeof(SourceChannelsKey)) == 0)
+            texture.sourceChannels = (uint32_t) std::atoi(std::string(pair + sizeof(SourceChannelsKey), length - sizeof(SourceChannelsKey)).c_str());
+        offset += padded(length);
+    }
+    offset = keyValueEnd;
+
+    // the payload is copied so the texture outlives the mapping
+    texture.data.assign(bytes + offset, bytes + file.Size());
+    size_t position = 0;
+    for (uint32_t level = 0; level < texture.levels; level++) {
+        if (position + 4 > texture.data.size())
+            return false;
+        uint32_t imageSize;
+        std::memcpy(&imageSize, texture.data.data() + position, 4);
+        position += 4;
+        for (uint32_t face = 0; face < texture.faces; face++) {
+            if (imageSize > texture.data.size() - position)
+                return false;
+            KtxImage image = {level, face, std::max(1u, texture.width >> level), std::max(1u, texture.height >> level), position, imageSize};
+            texture.images.push_back(image);
+            position += padded(imageSize);
+        }
+    }
+    return true;
+}
+
+// writes to a temporary file renamed over the target, like the mesh cache
+inline bool WriteKtx(const std::string& path, const KtxTexture& texture) {
+    using namespace ktx;
+    std::string channels = std::to_string(texture.sourceChannels);
+    uint32_t pairLength = (uint32_t) (sizeof(SourceChannelsKey) + channels.size() + 1);
+    Header header = {};
+    std::memcpy(header.identifier, Identifier, sizeof(Identifier));
+    header.endianness = Endianness;
+    header.glTypeSize = 1;
+    header.glInternalFormat = texture.internalFormat;
+    header.glBaseInternalFormat = texture.baseInternalFormat;
+    header.pixelWidth = texture.width;
+    header.pixelHeight = texture.height;
+    header.numberOfFaces = texture.faces;
+    header.numberOfMipmapLevels = texture.levels;
+    header.bytesOfKeyValueData = (uint32_t) (4 + padded(pairLength));
+
+    static const char zeros[4] = {};
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary);
+        if (!out)
+            return false;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(&pairLength), 4);
+        out.write(SourceChannelsKey, sizeof(SourceChannelsKey));
+        out.write(channels.c_str(), channels.size() + 1);
+        out.write(zeros, padded(pairLength) - pairLength);
+        for (uint32_t level = 0; level < texture.levels; level++) {
+            uint32_t imageSize = texture.Image(level).size;
+            out.write(reinterpret_cast<const char*>(&imageSize), 4);
+            for (uint32_t face = 0; face < texture.faces; face++) {
+                const KtxImage& image = texture.Image(level, face);
+                out.write(reinterpret_cast<const char*>(texture.data.data() + image.offset), image.size);
+                out.write(zeros, padded(image.size) - image.size);
+            }
+        }
+        if (!out)
+            return false;
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+#endif //PROJECT_BASE_KTX_H
@@ -0,0 +1,52 @@
+#ifndef PROJECT_BASE_MAPPEDFILE_H
+#define PROJECT_BASE_MAPPEDFILE_H
+
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Read only memory mapping of a whole file.
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    ~MappedFile() { Close(); }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool Open(const std::string& path) {
+        Close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) == 0 && info.st_size > 0) {
+            void* data = mmap(nullptr, (size_t) info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                m_Data = static_cast<const char*>(data);
+                m_Size = (size_t) info.st_size;
+            }
+        }
+        ::close(fd);
+        return m_Data != nullptr;
+    }
+
+    void Close() {
+        if (m_Data != nullptr)
+            munmap(const_cast<char*>(m_Data), m_Size);
+        m_Data = nullptr;
+        m_Size = 0;
+    }
+
+    const char* Data() const { return m_Data; }
+    size_t Size() const { return m_Size; }
+
+private:
+    const char* m_Data = nullptr;
+    size_t m_Size = 0;
+};
+
+#endif //PROJECT_BASE_MAPPEDFILE_H
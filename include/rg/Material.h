@@ -0,0 +1,113 @@
+#ifndef PROJECT_BASE_MATERIAL_H
+#define PROJECT_BASE_MATERIAL_H
+
+#include <glad/glad.h>
+#include <learnopengl/shader.h>
+#include <rg/GLState.h>
+#include <algorithm>
+#include <atomic>
+#include <string>
+#include <vector>
+
+struct Texture {
+    unsigned int id;
+    std::string type;
+    std::string path;
+};
+
+// specular exponent of materials that do not set one, what every model was drawn with before
+const float DefaultShininess = 32.0f;
+
+// Textures and scalar parameters of a surface, built once when a model is imported and shared by
+// all meshes with the same textures. Texture i is bound to unit i and sampled by the uniform named
+// after the LearnOpenGL convention, prefix + type + N (material.texture_diffuse1, ...). The
+// locations of the samplers and of prefix + "shininess" are looked up the first time a program
+// draws the material and kept per program, so binding it builds no strings.
+class Material {
+public:
+    static const unsigned int MaxTextures = 4;
+
+    struct ProgramLocations {
+        unsigned int program = 0;
+        int samplers[MaxTextures] = {-1, -1, -1, -1};
+        int shininess = -1;
+    };
+
+    Material(std::vector<Texture> textures, float shininess = DefaultShininess, const std::string& prefix = "")
+        : m_Textures(std::move(textures)), m_Shininess(shininess), m_Prefix(prefix), m_Id(nextId()) {
+        unsigned int diffuseNr = 1, specularNr = 1, normalNr = 1, heightNr = 1;
+        for (const Texture& texture : m_Textures) {
+            std::string number;
+            if (texture.type == "texture_diffuse")
+                number = std::to_string(diffuseNr++);
+            else if (texture.type == "texture_specular")
+                number = std::to_string(specularNr++);
+            else if (texture.type == "texture_normal")
+                number = std::to_string(normalNr++);
+            else if (texture.type == "texture_height")
+                number = std::to_string(heightNr++);
+            m_SamplerNames.push_back(texture.type + number);
+        }
+    }
+
+    Material(const Material&) = delete;
+    Material& operator=(const Material&) = delete;
+
+    // unique for the process, the render queue sorts and batches by it
+    unsigned int Id() const { return m_Id; }
+    const std::vector<Texture>& Textures() const { return m_Textures; }
+    unsigned int TextureCount() const { return (unsigned int) std::min<size_t>(m_Textures.size(), MaxTextures); }
+    float Shininess() const { return m_Shininess; }
+    const std::string& Prefix() const { return m_Prefix; }
+
+    void SetShininess(float shininess) { m_Shininess = shininess; }
+
+    // prefix of the sampler and parameter uniforms, e.g. "material.", drops the resolved locations
+    void SetPrefix(const std::string& prefix) {
+        m_Prefix = prefix;
+        m_Programs.clear();
+    }
+
+    const ProgramLocations& Locations(const Shader& shader) const {
+        for (const ProgramLocations& locations : m_Programs) {
+            if (locations.program == shader.ID)
+                return locations;
+        }
+        ProgramLocations locations;
+        locations.program = shader.ID;
+        for (unsigned int i = 0; i < TextureCount(); i++)
+            locations.samplers[i] = shader.getUniformLocation(m_Prefix + m_SamplerNames[i]);
+        locations.shininess = shader.getUniformLocation(m_Prefix + "shininess");
+        m_Programs.push_back(locations);
+        return m_Programs.back();
+    }
+
+    // sets the samplers and parameters in the shader, which has to be in use, and binds the textures
+    void Bind(const Shader& shader) const {
+        const ProgramLocations& locations = Locations(shader);
+        GLState& state = GLState::Get();
+        for (unsigned int i = 0; i < TextureCount(); i++) {
+            if (locations.samplers[i] >= 0)
+                shader.setInt(locations.samplers[i], (int) i);
+            state.BindTexture(i, GL_TEXTURE_2D, m_Textures[i].id);
+        }
+        if (locations.shininess >= 0)
+            shader.setFloat(locations.shininess, m_Shininess);
+    }
+
+private:
+    std::vector<Texture> m_Textures;
+    std::vector<std::string> m_SamplerNames;
+    float m_Shininess;
+    std::string m_Prefix;
+    unsigned int m_Id;
+    // one entry per program that drew the material, resolved on the GL thread
+    mutable std::vector<ProgramLocations> m_Programs;
+
+    static unsigned int nextId() {
+        static std::atomic<unsigned int> id{1};
+        return id.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+#endif //PROJECT_BASE_MATERIAL_H
@@ -0,0 +1,329 @@
+#ifndef PROJECT_BASE_MESHCACHE_H
+#define PROJECT_BASE_MESHCACHE_H
+
+#include <glm/glm.hpp>
+#include <learnopengl/mesh.h>
+#include <rg/CpuProfiler.h>
+#include <rg/MappedFile.h>
+#include <rg/VertexPacking.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// one mesh of an opened cache, the arrays point into the mapping
+struct CachedMesh {
+    MeshGeometry geometry;          // vertices and indices as they are uploaded
+    std::vector<Texture> textures;  // type and path, ids are left to the loader
+    float shininess;
+};
+
+// Processed meshes of a model, stored next to the source file so a warm start skips the importer.
+// A cache is valid for one source file content (FNV-1a hash), one set of import flags, one set of
+// vertex packing options and the contents of the files the source depends on, such as the
+// material libraries of an OBJ; any other file, flags, options, dependency, cache version or
+// Vertex layout makes Open fail and the model is imported again. Layout, all offsets from the
+// start of the file:
+//
+//   Header | MeshRecord[meshCount] | dependencies | per mesh: vertices, indices (16 byte aligned), texture refs
+//
+// vertices are stored in the layout they are drawn with, packed (VertexPacking.h) when the options
+// enable it, and indices in the type they are drawn with, 16 bits when Mesh::FitsShortIndices.
+// dependencies are a list of (uint64 hash, uint32 path length, path), the hash is 0 for a file
+// that was missing. texture refs are a list of (uint32 type length, uint32 path length, type, path).
+class MeshCache {
+public:
+    static const uint32_t Version = 5;
+
+    static std::string PathFor(const std::string& sourcePath) { return sourcePath + ".rgmesh"; }
+
+    static bool HashFile(const std::string& path, uint64_t& hash) {
+        RG_PROFILE_FUNCTION();
+        MappedFile file;
+        if (!file.Open(path))
+            return false;
+        hash = 14695981039346656037ull;
+        for (size_t i = 0; i < file.Size(); i++) {
+            hash ^= (unsigned char) file.Data()[i];
+            hash *= 1099511628211ull;
+        }
+        return true;
+    }
+
+    bool Open(const std::string& cachePath, uint64_t sourceHash, uint32_t importFlags, const VertexPackingOptions& packing) {
+        RG_PROFILE_FUNCTION();
+        m_Meshes.clear();
+        if (!m_File.Open(cachePath) || m_File.Size() < sizeof(Header))
+            return fail();
+        const Header& header = *reinterpret_cast<const Header*>(m_File.Data());
+        if (header.magic != Magic || header.version != Version || header.vertexSize != sizeof(Vertex)
+            || header.sourceHash != sourceHash || header.importFlags != importFlags || !header.SamePacking(packing)
+            || !inside(sizeof(Header), (uint64_t) header.meshCount * sizeof(MeshRecord)))
+            return fail();
+        if (!dependenciesUnchanged(sizeof(Header) + (uint64_t) header.meshCount * sizeof(MeshRecord), header.dependencyCount))
+            return fail();
+
+        const MeshRecord* records = reinterpret_cast<const MeshRecord*>(m_File.Data() + sizeof(Header));
+        for (uint32_t i = 0; i < header.meshCount; i++) {
+            const MeshRecord& record = records[i];
+            CachedMesh mesh;
+            MeshGeometry& geometry = mesh.geometry;
+            geometry.layout = record.Layout();
+            if ((record.indexType != GL_UNSIGNED_SHORT && record.indexType != GL_UNSIGNED_INT)
+                || geometry.layout.packed != packing.enabled || (!geometry.layout.packed && geometry.layout.stride != sizeof(Vertex))
+                || !inside(record.vertexOffset, (uint64_t) record.vertexCount * geometry.layout.stride)
+                || !inside(record.indexOffset, (uint64_t) record.indexCount * Mesh::IndexSize(record.indexType)))
+                return fail();
+            geometry.vertices = m_File.Data() + record.vertexOffset;
+            geometry.vertexCount = record.vertexCount;
+            std::memcpy(&geometry.positionTransform[0][0], record.positionTransform, sizeof(record.positionTransform));
+            geometry.packingReport.positionError = record.packingErrors[0];
+            geometry.packingReport.normalError = record.packingErrors[1];
+            geometry.packingReport.texCoordError = record.packingErrors[2];
+            geometry.packingReport.tangentError = record.packingErrors[3];
+            geometry.packingReport.bytes = (size_t) record.vertexCount * geometry.layout.stride;
+            geometry.packingReport.unpackedBytes = (size_t) record.vertexCount * sizeof(Vertex);
+            geometry.indices = m_File.Data() + record.indexOffset;
+            geometry.indexType = record.indexType;
+            geometry.indexCount = record.indexCount;
+            geometry.boundsMin = glm::vec3(record.bounds[0], record.bounds[1], record.bounds[2]);
+            geometry.boundsMax = glm::vec3(record.bounds[3], record.bounds[4], record.bounds[5]);
+            geometry.boundsCenter = glm::vec3(record.bounds[6], record.bounds[7], record.bounds[8]);
+            geometry.boundsRadius = record.bounds[9];
+            mesh.shininess = record.shininess;
+            if (!readTextures(record, mesh.textures))
+                return fail();
+            m_Meshes.push_back(mesh);
+        }
+        return true;
+    }
+
+    // the mapping stays open until Close or the next Open
+    void Close() {
+        m_Meshes.clear();
+        m_File.Close();
+    }
+
+    const std::vector<CachedMesh>& Meshes() const { return m_Meshes; }
+
+    // Writes to a temporary file renamed over the cache, so a crash never leaves a torn cache. The
+    // meshes need their vertices; packed ones are packed again, which gives the bytes they were
+    // uploaded with.
+    static bool Write(const std::string& cachePath, uint64_t sourceHash, uint32_t importFlags, const VertexPackingOptions& packing,
+                      const std::vector<std::string>& dependencies, const std::vector<Mesh>& meshes) {
+        RG_PROFILE_FUNCTION();
+        Header header = {Magic, Version, (uint32_t) sizeof(Vertex), importFlags, sourceHash, (uint32_t) meshes.size(),
+                         (uint32_t) dependencies.size(), Header::PackingFlags(packing),
+                         {packing.positionTolerance, packing.normalTolerance, packing.texCoordTolerance}};
+        std::vector<PackedVertices> packed(meshes.size());
+        if (packing.enabled) {
+            for (size_t i = 0; i < meshes.size(); i++)
+                packed[i] = PackVertices(meshes[i].vertices.data(), meshes[i].vertices.size(), meshes[i].BoundsCenter, packing);
+        }
+        std::vector<MeshRecord> records(meshes.size());
+        uint64_t offset = sizeof(Header) + meshes.size() * sizeof(MeshRecord);
+        for (const std::string& dependency : dependencies)
+            offset += sizeof(uint64_t) + sizeof(uint32_t) + dependency.size();
+        for (size_t i = 0; i < meshes.size(); i++) {
+            const Mesh& mesh = meshes[i];
+            MeshRecord& record = records[i];
+            record.vertexOffset = offset = align(offset);
+            record.vertexCount = (uint32_t) mesh.vertices.size();
+            record.SetLayout(mesh.Layout);
+            offset += mesh.vertices.size() * mesh.Layout.stride;
+            record.indexOffset = offset = align(offset);
+            record.indexCount = (uint32_t) mesh.indices.size();
+            record.indexType = Mesh::FitsShortIndices(mesh.vertices.size()) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+            offset += mesh.indices.size() * Mesh::IndexSize(record.indexType);
+            record.textureOffset = offset;
+            record.textureCount = (uint32_t) texturesOf(mesh).size();
+            record.shininess = mesh.material ? mesh.material->Shininess() : DefaultShininess;
+            for (const Texture& texture : texturesOf(mesh))
+                offset += 2 * sizeof(uint32_t) + texture.type.size() + texture.path.size();
+            const float bounds[10] = {mesh.BoundsMin.x, mesh.BoundsMin.y, mesh.BoundsMin.z,
+                                      mesh.BoundsMax.x, mesh.BoundsMax.y, mesh.BoundsMax.z,
+                                      mesh.BoundsCenter.x, mesh.BoundsCenter.y, mesh.BoundsCenter.z, mesh.BoundsRadius};
+            std::copy(bounds, bounds + 10, record.bounds);
+            std::memcpy(record.positionTransform, &mesh.PositionTransform[0][0], sizeof(record.positionTransform));
+            const float errors[4] = {mesh.PackingReport.positionError, mesh.PackingReport.normalError,
+                                     mesh.PackingReport.texCoordError, mesh.PackingReport.tangentError};
+            std::copy(errors, errors + 4, record.packingErrors);
+        }
+
+        std::string temporary = cachePath + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary);
+            if (!out)
+                return false;
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(MeshRecord));
+            for (const std::string& dependency : dependencies) {
+                uint64_t hash = 0; // stays 0 for a missing file
+                HashFile(dependency, hash);
+                uint32_t length = (uint32_t) dependency.size();
+                out.write(reinterpret_cast<const char*>(&hash), sizeof(hash));
+                out.write(reinterpret_cast<const char*>(&length), sizeof(length));
+                out.write(dependency.data(), dependency.size());
+            }
+            for (size_t i = 0; i < meshes.size(); i++) {
+                const Mesh& mesh = meshes[i];
+                pad(out, records[i].vertexOffset);
+                if (packing.enabled)
+                    out.write(reinterpret_cast<const char*>(packed[i].data.data()), packed[i].data.size());
+                else
+                    out.write(reinterpret_cast<const char*>(mesh.vertices.data()), mesh.vertices.size() * sizeof(Vertex));
+                pad(out, records[i].indexOffset);
+                if (records[i].indexType == GL_UNSIGNED_SHORT) {
+                    std::vector<unsigned short> shortIndices(mesh.indices.begin(), mesh.indices.end());
+                    out.write(reinterpret_cast<const char*>(shortIndices.data()), shortIndices.size() * sizeof(unsigned short));
+                } else {
+                    out.write(reinterpret_cast<const char*>(mesh.indices.data()), mesh.indices.size() * sizeof(unsigned int));
+                }
+                for (const Texture& texture : texturesOf(mesh)) {
+                    uint32_t lengths[2] = {(uint32_t) texture.type.size(), (uint32_t) texture.path.size()};
+                    out.write(reinterpret_cast<const char*>(lengths), sizeof(lengths));
+                    out.write(texture.type.data(), texture.type.size());
+                    out.write(texture.path.data(), texture.path.size());
+                }
+            }
+            if (!out)
+                return false;
+        }
+        return std::rename(temporary.c_str(), cachePath.c_str()) == 0;
+    }
+
+private:
+    static const uint32_t Magic = 0x434d4752; // "RGMC"
+
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t vertexSize;
+        uint32_t importFlags;
+        uint64_t sourceHash;
+        uint32_t meshCount;
+        uint32_t dependencyCount;
+        uint32_t packingFlags;
+        float packingTolerances[3];     // position, normal, texCoord
+
+        static uint32_t PackingFlags(const VertexPackingOptions& packing) {
+            return (packing.enabled ? 1u : 0u) | (packing.tangents ? 2u : 0u);
+        }
+
+        bool SamePacking(const VertexPackingOptions& packing) const {
+            return packingFlags == PackingFlags(packing) && packingTolerances[0] == packing.positionTolerance
+                   && packingTolerances[1] == packing.normalTolerance && packingTolerances[2] == packing.texCoordTolerance;
+        }
+    };
+
+    struct MeshRecord {
+        uint64_t vertexOffset;
+        uint64_t indexOffset;
+        uint64_t textureOffset;
+        uint32_t vertexCount;
+        uint32_t indexCount;
+        uint32_t textureCount;
+        uint32_t indexType;     // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+        float bounds[10];       // min, max, center, radius
+        float shininess;        // of the mesh's material
+        // VertexLayout: packed, quantizedPositions, halfTexCoords and tangents bits, stride, offsets
+        uint32_t layoutFlags;
+        uint32_t layoutOffsets[4];
+        float positionTransform[16];
+        float packingErrors[4]; // position, normal, texCoord, tangent
+
+        VertexLayout Layout() const {
+            VertexLayout layout;
+            layout.packed = (layoutFlags & 1u) != 0;
+            layout.quantizedPositions = (layoutFlags & 2u) != 0;
+            layout.halfTexCoords = (layoutFlags & 4u) != 0;
+            layout.tangents = (layoutFlags & 8u) != 0;
+            layout.stride = layoutOffsets[0];
+            layout.normalOffset = layoutOffsets[1];
+            layout.texCoordOffset = layoutOffsets[2];
+            layout.tangentOffset = layoutOffsets[3];
+            return layout;
+        }
+
+        void SetLayout(const VertexLayout& layout) {
+            layoutFlags = (layout.packed ? 1u : 0u) | (layout.quantizedPositions ? 2u : 0u)
+                          | (layout.halfTexCoords ? 4u : 0u) | (layout.tangents ? 8u : 0u);
+            layoutOffsets[0] = layout.stride;
+            layoutOffsets[1] = layout.normalOffset;
+            layoutOffsets[2] = layout.texCoordOffset;
+            layoutOffsets[3] = layout.tangentOffset;
+        }
+    };
+
+    MappedFile m_File;
+    std::vector<CachedMesh> m_Meshes;
+
+    static const std::vector<Texture>& texturesOf(const Mesh& mesh) {
+        static const std::vector<Texture> none;
+        return mesh.material ? mesh.material->Textures() : none;
+    }
+
+    static uint64_t align(uint64_t offset) { return (offset + 15) & ~(uint64_t) 15; }
+
+    static void pad(std::ostream& out, uint64_t offset) {
+        static const char zeros[16] = {};
+        out.write(zeros, (std::streamsize) (offset - (uint64_t) out.tellp()));
+    }
+
+    bool inside(uint64_t offset, uint64_t size) const {
+        return offset <= m_File.Size() && size <= m_File.Size() - offset;
+    }
+
+    bool fail() {
+        Close();
+        return false;
+    }
+
+    // true when every dependency listed at offset still hashes to what it did when the cache was written
+    bool dependenciesUnchanged(uint64_t offset, uint32_t count) const {
+        for (uint32_t i = 0; i < count; i++) {
+            if (!inside(offset, sizeof(uint64_t) + sizeof(uint32_t)))
+                return false;
+            // dependencies are not aligned
+            uint64_t hash;
+            uint32_t length;
+            std::memcpy(&hash, m_File.Data() + offset, sizeof(hash));
+            std::memcpy(&length, m_File.Data() + offset + sizeof(hash), sizeof(length));
+            offset += sizeof(hash) + sizeof(length);
+            if (!inside(offset, length))
+                return false;
+            uint64_t current = 0;
+            HashFile(std::string(m_File.Data() + offset, length), current);
+            if (current != hash)
+                return false;
+            offset += length;
+        }
+        return true;
+    }
+
+    bool readTextures(const MeshRecord& record, std::vector<Texture>& textures) const {
+        uint64_t offset = record.textureOffset;
+        for (uint32_t i = 0; i < record.textureCount; i++) {
+            if (!inside(offset, 2 * sizeof(uint32_t)))
+                return false;
+            // texture refs are not aligned
+            uint32_t lengths[2];
+            std::memcpy(lengths, m_File.Data() + offset, sizeof(lengths));
+            offset += 2 * sizeof(uint32_t);
+            if (!inside(offset, (uint64_t) lengths[0] + lengths[1]))
+                return false;
+            Texture texture;
+            texture.id = 0;
+            texture.type.assign(m_File.Data() + offset, lengths[0]);
+            texture.path.assign(m_File.Data() + offset + lengths[0], lengths[1]);
+            offset += lengths[0] + lengths[1];
+            textures.push_back(texture);
+        }
+        return true;
+    }
+};
+
+#endif //PROJECT_BASE_MESHCACHE_H
@@ -0,0 +1,211 @@
+#ifndef PROJECT_BASE_MESHOPTIMIZER_H
+#define PROJECT_BASE_MESHOPTIMIZER_H
+
+#include <learnopengl/mesh.h>
+#include <rg/CpuProfiler.h>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+// before and after numbers of one or more optimized meshes
+struct MeshOptimizationReport {
+    size_t verticesBefore = 0;
+    size_t verticesAfter = 0;
+    size_t indices = 0;
+    size_t missesBefore = 0;        // FIFO cache misses, ACMR = misses / triangles
+    size_t missesAfter = 0;
+    size_t bytesBefore = 0;         // Vertex array plus 32 bit indices
+    size_t bytesAfter = 0;          // Vertex array plus indices at the size the mesh uploads them
+
+    double AcmrBefore() const { return indices > 0 ? 3.0 * missesBefore / indices : 0.0; }
+    double AcmrAfter() const { return indices > 0 ? 3.0 * missesAfter / indices : 0.0; }
+
+    void Merge(const MeshOptimizationReport& other) {
+        verticesBefore += other.verticesBefore;
+        verticesAfter += other.verticesAfter;
+        indices += other.indices;
+        missesBefore += other.missesBefore;
+        missesAfter += other.missesAfter;
+        bytesBefore += other.bytesBefore;
+        bytesAfter += other.bytesAfter;
+    }
+};
+
+// Import time optimizer for indexed triangle lists, run on every mesh before it is uploaded:
+//   1. weld vertices that are bitwise identical
+//   2. reorder triangles for the post-transform cache (Tipsify, Sander et al. 2007)
+//   3. reorder vertices in the order the triangles first use them, for fetch locality
+// Meshes with at most 65536 vertices then upload 16 bit indices (Mesh::setupMesh).
+class MeshOptimizer {
+public:
+    static const unsigned int CacheSize = 16;
+
+    static MeshOptimizationReport Optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+        RG_PROFILE_FUNCTION();
+        MeshOptimizationReport report;
+        report.verticesBefore = vertices.size();
+        report.indices = indices.size();
+        report.missesBefore = CacheMisses(indices, vertices.size());
+        report.bytesBefore = vertices.size() * sizeof(Vertex) + indices.size() * sizeof(unsigned int);
+
+        WeldVertices(vertices, indices);
+        OptimizeVertexCache(indices, vertices.size());
+        OptimizeVertexFetch(vertices, indices);
+
+        report.verticesAfter = vertices.size();
+        report.missesAfter = CacheMisses(indices, vertices.size());
+        report.bytesAfter = vertices.size() * sizeof(Vertex) + indices.size() * (Mesh::FitsShortIndices(vertices.size()) ? 2 : 4);
+        return report;
+    }
+
+    // merges vertices with the same bytes and remaps the indices to the survivors
+    static void WeldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+        RG_PROFILE_FUNCTION();
+        std::unordered_map<VertexKey, unsigned int, VertexKeyHash> unique;
+        unique.reserve(vertices.size());
+        std::vector<unsigned int> remap(vertices.size());
+        std::vector<Vertex> welded;
+        welded.reserve(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            auto inserted = unique.emplace(VertexKey{&vertices[i]}, (unsigned int) welded.size());
+            if (inserted.second)
+                welded.push_back(vertices[i]);
+            remap[i] = inserted.first->second;
+        }
+        for (unsigned int& index : indices)
+            index = remap[index];
+        vertices.swap(welded);
+    }
+
+    // Tipsify: fans around the most recently used vertex that still has triangles left, jumps to a
+    // dead end vertex or the next live vertex in order when the fan can not continue
+    static void OptimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount) {
+        RG_PROFILE_FUNCTION();
+        size_t triangleCount = indices.size() / 3;
+        if (triangleCount == 0)
+            return;
+        // triangles adjacent to each vertex, as offsets into one array
+        std::vector<unsigned int> live(vertexCount, 0);
+        for (unsigned int index : indices)
+            live[index]++;
+        std::vector<unsigned int> offsets(vertexCount + 1, 0);
+        for (size_t v = 0; v < vertexCount; v++)
+            offsets[v + 1] = offsets[v] + live[v];
+        std::vector<unsigned int> adjacency(indices.size());
+        std::vector<unsigned int> fill(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < indices.size(); i++)
+            adjacency[fill[indices[i]]++] = (unsigned int) (i / 3);
+
+        std::vector<unsigned int> timestamps(vertexCount, 0);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<unsigned int> deadEnds;
+        std::vector<unsigned int> candidates;
+        std::vector<unsigned int> result;
+        result.reserve(indices.size());
+        unsigned int time = CacheSize + 1;
+        size_t cursor = 0;
+        long fanning = 0;
+        while (fanning >= 0) {
+            candidates.clear();
+            for (unsigned int a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+                unsigned int triangle = adjacency[a];
+                if (emitted[triangle])
+                    continue;
+                for (int corner = 0; corner < 3; corner++) {
+                    unsigned int v = indices[3 * triangle + corner];
+                    result.push_back(v);
+                    deadEnds.push_back(v);
+                    candidates.push_back(v);
+                    live[v]--;
+                    if (time - timestamps[v] > CacheSize)
+                        timestamps[v] = time++;
+                }
+                emitted[triangle] = true;
+            }
+            fanning = nextVertex(candidates, timestamps, time, live, deadEnds, cursor);
+        }
+        indices.swap(result);
+    }
+
+    // renumbers the vertices in order of first use, unreferenced ones are dropped
+    static void OptimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+        RG_PROFILE_FUNCTION();
+        const unsigned int unused = ~0u;
+        std::vector<unsigned int> remap(vertices.size(), unused);
+        std::vector<Vertex> ordered;
+        ordered.reserve(vertices.size());
+        for (unsigned int& index : indices) {
+            if (remap[index] == unused) {
+                remap[index] = (unsigned int) ordered.size();
+                ordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices.swap(ordered);
+    }
+
+    // vertex shader invocations of a FIFO post-transform cache of CacheSize entries
+    static size_t CacheMisses(const std::vector<unsigned int>& indices, size_t vertexCount) {
+        std::vector<unsigned int> enteredAt(vertexCount, 0);
+        size_t misses = 0;
+        for (unsigned int index : indices) {
+            // entries are numbered from 1, so 0 means never cached
+            if (enteredAt[index] == 0 || misses + 1 - enteredAt[index] > CacheSize)
+                enteredAt[index] = (unsigned int) ++misses;
+        }
+        return misses;
+    }
+
+private:
+    struct VertexKey {
+        const Vertex* vertex;
+        bool operator==(const VertexKey& other) const { return std::memcmp(vertex, other.vertex, sizeof(Vertex)) == 0; }
+    };
+
+    struct VertexKeyHash {
+        size_t operator()(const VertexKey& key) const {
+            const unsigned char* bytes = reinterpret_cast<const unsigned char*>(key.vertex);
+            uint64_t hash = 14695981039346656037ull;
+            for (size_t i = 0; i < sizeof(Vertex); i++) {
+                hash ^= bytes[i];
+                hash *= 1099511628211ull;
+            }
+            return (size_t) hash;
+        }
+    };
+
+    // the candidate that stays in the cache the longest while its remaining triangles are drawn,
+    // otherwise any vertex with triangles left
+    static long nextVertex(const std::vector<unsigned int>& candidates, const std::vector<unsigned int>& timestamps, unsigned int time,
+                           const std::vector<unsigned int>& live, std::vector<unsigned int>& deadEnds, size_t& cursor) {
+        long best = -1;
+        long bestPriority = -1;
+        for (unsigned int v : candidates) {
+            if (live[v] == 0)
+                continue;
+            long priority = 0;
+            if (time - timestamps[v] + 2 * live[v] <= CacheSize)
+                priority = time - timestamps[v];
+            if (priority > bestPriority) {
+                bestPriority = priority;
+                best = v;
+            }
+        }
+        if (best >= 0)
+            return best;
+        while (!deadEnds.empty()) {
+            unsigned int v = deadEnds.back();
+            deadEnds.pop_back();
+            if (live[v] > 0)
+                return v;
+        }
+        for (; cursor < live.size(); cursor++) {
+            if (live[cursor] > 0)
+                return (long) cursor;
+        }
+        return -1;
+    }
+};
+
+#endif //PROJECT_BASE_MESHOPTIMIZER_H
@@ -0,0 +1,88 @@
+#ifndef PROJECT_BASE_OBJBENCHMARK_H
+#define PROJECT_BASE_OBJBENCHMARK_H
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+#include <learnopengl/model.h>
+#include <rg/JobSystem.h>
+#include <rg/ObjLoader.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct ObjBenchmarkResult {
+    std::string path;
+    double assimpMs;        // best of the iterations
+    double serialMs;
+    double parallelMs;
+    size_t assimpVertices;
+    size_t nativeVertices;
+    size_t triangles;
+};
+
+// Times the CPU side of importing each model, without GL uploads or textures: Assimp with
+// Model::ImportFlags plus the copy into Vertex arrays Model::processMesh does, against ObjLoader
+// on the calling thread and on the job system. Results are printed to stdout and returned.
+inline std::vector<ObjBenchmarkResult> RunObjBenchmark(const std::vector<std::string>& paths, JobSystem& jobs, int iterations = 10) {
+    typedef std::chrono::steady_clock Clock;
+    auto best = [&](const std::function<void()>& run) {
+        double fastest = 1e30;
+        for (int i = 0; i < iterations; i++) {
+            auto start = Clock::now();
+            run();
+            fastest = std::min(fastest, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        }
+        return fastest;
+    };
+
+    std::vector<ObjBenchmarkResult> results;
+    for (const std::string& path : paths) {
+        ObjBenchmarkResult result = {path, 0.0, 0.0, 0.0, 0, 0, 0};
+        result.assimpMs = best([&]() {
+            Assimp::Importer importer;
+            const aiScene* scene = importer.ReadFile(path, Model::ImportFlags);
+            result.assimpVertices = 0;
+            for (unsigned int m = 0; scene != nullptr && m < scene->mNumMeshes; m++) {
+                const aiMesh* mesh = scene->mMeshes[m];
+                std::vector<Vertex> vertices(mesh->mNumVertices);
+                for (unsigned int i = 0; i < mesh->mNumVertices; i++) {
+                    vertices[i].Position = glm::vec3(mesh->mVertices[i].x, mesh->mVertices[i].y, mesh->mVertices[i].z);
+                    if (mesh->HasNormals())
+                        vertices[i].Normal = glm::vec3(mesh->mNormals[i].x, mesh->mNormals[i].y, mesh->mNormals[i].z);
+                    if (mesh->mTextureCoords[0]) {
+                        vertices[i].TexCoords = glm::vec2(mesh->mTextureCoords[0][i].x, mesh->mTextureCoords[0][i].y);
+                        vertices[i].Tangent = glm::vec3(mesh->mTangents[i].x, mesh->mTangents[i].y, mesh->mTangents[i].z);
+                        vertices[i].Bitangent = glm::vec3(mesh->mBitangents[i].x, mesh->mBitangents[i].y, mesh->mBitangents[i].z);
+                    }
+                }
+                std::vector<unsigned int> indices;
+                for (unsigned int f = 0; f < mesh->mNumFaces; f++)
+                    indices.insert(indices.end(), mesh->mFaces[f].mIndices, mesh->mFaces[f].mIndices + mesh->mFaces[f].mNumIndices);
+                result.assimpVertices += vertices.size();
+            }
+        });
+
+        ObjLoader serial;
+        result.serialMs = best([&]() { serial.Load(path); });
+        ObjLoader parallel(&jobs);
+        result.parallelMs = best([&]() { parallel.Load(path); });
+        for (const ObjMesh& mesh : parallel.Meshes()) {
+            result.nativeVertices += mesh.vertices.size();
+            result.triangles += mesh.indices.size() / 3;
+        }
+        printf("%s: %zu triangles\n"
+               "  assimp          %8.2f ms, %zu vertices\n"
+               "  native 1 thread %8.2f ms, %zu vertices\n"
+               "  native %u threads %6.2f ms\n",
+               path.c_str(), result.triangles, result.assimpMs, result.assimpVertices,
+               result.serialMs, result.nativeVertices, jobs.ThreadCount(), result.parallelMs);
+        results.push_back(result);
+    }
+    return results;
+}
+
+#endif //PROJECT_BASE_OBJBENCHMARK_H
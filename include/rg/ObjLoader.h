@@ -0,0 +1,607 @@
+#ifndef PROJECT_BASE_OBJLOADER_H
+#define PROJECT_BASE_OBJLOADER_H
+
+#include <glm/glm.hpp>
+#include <learnopengl/mesh.h>
+#include <rg/CpuProfiler.h>
+#include <rg/JobSystem.h>
+#include <rg/MappedFile.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace objparsing {
+
+    inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+    inline const char* skipSpaces(const char* p, const char* end) {
+        while (p < end && isSpace(*p))
+            p++;
+        return p;
+    }
+
+    inline const char* lineEnd(const char* p, const char* end) {
+        const char* newline = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        return newline != nullptr ? newline : end;
+    }
+
+    // rest of the line without surrounding whitespace, file names may contain spaces
+    inline std::string restOfLine(const char* p, const char* end) {
+        p = skipSpaces(p, end);
+        while (end > p && isSpace(end[-1]))
+            end--;
+        return std::string(p, end);
+    }
+
+    // true when the line starts with the keyword followed by whitespace
+    inline bool keyword(const char* p, const char* end, const char* word, size_t length) {
+        return (size_t) (end - p) > length && std::memcmp(p, word, length) == 0 && isSpace(p[length]);
+    }
+
+    // decimal float without locale or errno handling, exact for up to 19 significant digits
+    // and exponents within the range doubles represent exactly
+    inline const char* parseFloat(const char* p, const char* end, float& value) {
+        static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        uint64_t mantissa = 0;
+        int exponent = 0;
+        int digits = 0;
+        const char* start = p;
+        for (; p < end && *p >= '0' && *p <= '9'; p++) {
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa > 0;
+            } else {
+                exponent++;
+            }
+        }
+        if (p < end && *p == '.') {
+            for (p++; p < end && *p >= '0' && *p <= '9'; p++) {
+                if (digits < 19) {
+                    mantissa = mantissa * 10 + (*p - '0');
+                    digits += mantissa > 0;
+                    exponent--;
+                }
+            }
+        }
+        if (p == start)
+            return nullptr;
+        if (p < end && (*p == 'e' || *p == 'E')) {
+            p++;
+            bool negativeExponent = false;
+            if (p < end && (*p == '-' || *p == '+'))
+                negativeExponent = *p++ == '-';
+            int e = 0;
+            for (; p < end && *p >= '0' && *p <= '9'; p++)
+                e = std::min(e * 10 + (*p - '0'), 9999);
+            exponent += negativeExponent ? -e : e;
+        }
+        double result = (double) mantissa;
+        if (exponent < 0)
+            result = exponent >= -22 ? result / powers[-exponent] : result * std::pow(10.0, exponent);
+        else if (exponent > 0)
+            result = exponent <= 22 ? result * powers[exponent] : result * std::pow(10.0, exponent);
+        value = (float) (negative ? -result : result);
+        return p;
+    }
+
+    inline const char* parseInt(const char* p, const char* end, long& value) {
+        bool negative = false;
+        if (p < end && (*p == '-' || *p == '+'))
+            negative = *p++ == '-';
+        const char* start = p;
+        long result = 0;
+        for (; p < end && *p >= '0' && *p <= '9'; p++)
+            result = result * 10 + (*p - '0');
+        if (p == start)
+            return nullptr;
+        value = negative ? -result : result;
+        return p;
+    }
+
+}
+
+// one mesh the way Model::processMesh builds it from an aiMesh; texture ids are left to the caller
+struct ObjMesh {
+    std::string name;
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    std::vector<Texture> textures;
+    float shininess = DefaultShininess; // Ns of the material
+};
+
+// Wavefront OBJ/MTL loader producing the same meshes as Assimp with Model::ImportFlags: polygons
+// are fan triangulated, one mesh per object/group and material, missing normals are smoothed over
+// shared positions, V is flipped and tangents/bitangents are computed for meshes with UVs.
+// Vertices sharing position, UV and normal indices are merged.
+//
+// The file is mapped and split into line aligned chunks parsed in parallel in two passes: the
+// first counts the v/vt/vn lines of each chunk and the object/material it ends in, which gives
+// every chunk the array offsets and state it starts with, the second parses the chunks straight
+// into the shared arrays. Meshes are then assembled in parallel.
+class ObjLoader {
+public:
+    // without a job system everything runs on the calling thread
+    explicit ObjLoader(JobSystem* jobs = nullptr) : m_Jobs(jobs) {}
+
+    bool Load(const std::string& path) {
+        RG_PROFILE_FUNCTION();
+        m_Meshes.clear();
+        m_Error.clear();
+        m_Libraries.clear();
+        MappedFile file;
+        if (!file.Open(path))
+            return fail("cannot open " + path);
+        m_Directory = path.substr(0, path.find_last_of('/'));
+
+        splitChunks(file.Data(), file.Size());
+        forEachChunk([&](Chunk& chunk) { count(chunk); });
+        Chunk total;
+        for (Chunk& chunk : m_Chunks) {
+            chunk.positionBase = total.positions;
+            chunk.texCoordBase = total.texCoords;
+            chunk.normalBase = total.normals;
+            chunk.object = total.object;
+            chunk.material = total.material;
+            total.positions += chunk.positions;
+            total.texCoords += chunk.texCoords;
+            total.normals += chunk.normals;
+            if (chunk.objectChanged)
+                total.object = chunk.lastObject;
+            if (chunk.materialChanged)
+                total.material = chunk.lastMaterial;
+        }
+        m_Positions.assign(total.positions, glm::vec3(0.0f));
+        m_TexCoords.assign(total.texCoords, glm::vec2(0.0f));
+        m_Normals.assign(total.normals, glm::vec3(0.0f));
+        forEachChunk([&](Chunk& chunk) { parse(chunk); });
+        for (const Chunk& chunk : m_Chunks) {
+            if (!chunk.error.empty())
+                return fail(path + ": " + chunk.error);
+        }
+
+        for (const Chunk& chunk : m_Chunks) {
+            for (const std::string& library : chunk.libraries)
+                m_Libraries.push_back(m_Directory + '/' + library);
+        }
+        for (const std::string& library : m_Libraries) {
+            if (!loadMaterials(library))
+                return fail("cannot open material library " + library);
+        }
+        if (!gatherMeshes())
+            return fail(path + ": face index out of range");
+        forEachIndex(m_Gathered.size(), [&](size_t i) { assemble(m_Gathered[i], m_Meshes[i]); });
+        m_Gathered.clear();
+        m_Chunks.clear();
+        m_Positions.clear();
+        m_TexCoords.clear();
+        m_Normals.clear();
+        return true;
+    }
+
+    const std::vector<ObjMesh>& Meshes() const { return m_Meshes; }
+    std::vector<ObjMesh>& Meshes() { return m_Meshes; }
+    const std::string& Error() const { return m_Error; }
+    // paths of the material libraries the file references, also when one of them failed to load
+    const std::vector<std::string>& Libraries() const { return m_Libraries; }
+
+private:
+    static const size_t MinChunkSize = 64 * 1024;
+
+    // indices resolved to 0 based, -1 when missing
+    struct Corner {
+        int position;
+        int texCoord;
+        int normal;
+
+        bool operator==(const Corner& other) const {
+            return position == other.position && texCoord == other.texCoord && normal == other.normal;
+        }
+    };
+
+    struct CornerHash {
+        size_t operator()(const Corner& corner) const {
+            uint64_t h = (uint64_t) (uint32_t) corner.position * 0x9e3779b97f4a7c15ull;
+            h ^= (uint64_t) (uint32_t) corner.texCoord * 0xc2b2ae3d27d4eb4full + (h << 6) + (h >> 2);
+            h ^= (uint64_t) (uint32_t) corner.normal * 0x165667b19e3779f9ull + (h << 6) + (h >> 2);
+            return (size_t) h;
+        }
+    };
+
+    // triangles from firstCorner on belong to object/material until the next segment
+    struct Segment {
+        size_t firstCorner;
+        std::string object;
+        std::string material;
+    };
+
+    struct Chunk {
+        const char* begin = nullptr;
+        const char* end = nullptr;
+        // first pass
+        size_t positions = 0, texCoords = 0, normals = 0;
+        bool objectChanged = false, materialChanged = false;
+        std::string lastObject, lastMaterial;
+        // state at the start of the chunk
+        size_t positionBase = 0, texCoordBase = 0, normalBase = 0;
+        std::string object, material;
+        // second pass
+        std::vector<Corner> corners;    // three per triangle
+        std::vector<Segment> segments;
+        std::vector<std::string> libraries;
+        std::string error;
+    };
+
+    struct Material {
+        std::string diffuse, specular, bump, ambient;
+        float shininess = DefaultShininess;
+    };
+
+    // corners of one output mesh, in file order
+    struct Gathered {
+        std::string object;
+        std::string material;
+        std::vector<Corner> corners;
+    };
+
+    JobSystem* m_Jobs;
+    std::string m_Directory;
+    std::string m_Error;
+    std::vector<Chunk> m_Chunks;
+    std::vector<glm::vec3> m_Positions;
+    std::vector<glm::vec2> m_TexCoords;
+    std::vector<glm::vec3> m_Normals;
+    std::map<std::string, Material> m_Materials;
+    std::vector<Gathered> m_Gathered;
+    std::vector<ObjMesh> m_Meshes;
+    std::vector<std::string> m_Libraries;
+
+    bool fail(const std::string& error) {
+        m_Error = error;
+        m_Meshes.clear();
+        m_Chunks.clear();
+        m_Gathered.clear();
+        return false;
+    }
+
+    template<typename Body>
+    void forEachIndex(size_t count, const Body& body) {
+        if (m_Jobs == nullptr || count == 1) {
+            for (size_t i = 0; i < count; i++)
+                body(i);
+            return;
+        }
+        m_Jobs->ParallelFor(0, count, 1, [&](size_t first, size_t last) {
+            for (size_t i = first; i < last; i++)
+                body(i);
+        });
+    }
+
+    template<typename Body>
+    void forEachChunk(const Body& body) {
+        forEachIndex(m_Chunks.size(), [&](size_t i) { body(m_Chunks[i]); });
+    }
+
+    void splitChunks(const char* data, size_t size) {
+        size_t threads = m_Jobs != nullptr ? m_Jobs->ThreadCount() : 1;
+        size_t count = std::max<size_t>(1, std::min(threads * 4, size / MinChunkSize));
+        const char* end = data + size;
+        const char* begin = data;
+        m_Chunks.assign(count, Chunk());
+        for (size_t i = 0; i < count; i++) {
+            const char* split = i + 1 == count ? end : std::max(begin, data + size * (i + 1) / count);
+            // chunks end after a newline
+            const char* newline = split < end ? objparsing::lineEnd(split, end) : end;
+            split = newline < end ? newline + 1 : end;
+            m_Chunks[i].begin = begin;
+            m_Chunks[i].end = split;
+            begin = split;
+        }
+    }
+
+    template<typename Line>
+    static void forEachLine(const Chunk& chunk, const Line& line) {
+        for (const char* p = chunk.begin; p < chunk.end;) {
+            const char* end = objparsing::lineEnd(p, chunk.end);
+            const char* start = objparsing::skipSpaces(p, end);
+            if (start < end && *start != '#')
+                line(start, end);
+            p = end + 1;
+        }
+    }
+
+    static void count(Chunk& chunk) {
+        forEachLine(chunk, [&](const char* p, const char* end) {
+            if (objparsing::keyword(p, end, "v", 1))
+                chunk.positions++;
+            else if (objparsing::keyword(p, end, "vt", 2))
+                chunk.texCoords++;
+            else if (objparsing::keyword(p, end, "vn", 2))
+                chunk.normals++;
+            else if (objparsing::keyword(p, end, "o", 1) || objparsing::keyword(p, end, "g", 1)) {
+                chunk.objectChanged = true;
+                chunk.lastObject = objparsing::restOfLine(p + 1, end);
+            } else if (objparsing::keyword(p, end, "usemtl", 6)) {
+                chunk.materialChanged = true;
+                chunk.lastMaterial = objparsing::restOfLine(p + 6, end);
+            }
+        });
+    }
+
+    void parse(Chunk& chunk) {
+        size_t positions = chunk.positionBase, texCoords = chunk.texCoordBase, normals = chunk.normalBase;
+        std::string object = chunk.object, material = chunk.material;
+        chunk.segments.push_back(Segment{0, object, material});
+        std::vector<Corner> polygon;
+        forEachLine(chunk, [&](const char* p, const char* end) {
+            if (!chunk.error.empty())
+                return;
+            if (objparsing::keyword(p, end, "v", 1)) {
+                if (!parseFloats(p + 1, end, &m_Positions[positions++][0], 3))
+                    chunk.error = "bad vertex: " + std::string(p, end);
+            } else if (objparsing::keyword(p, end, "vt", 2)) {
+                // a third coordinate is allowed and ignored
+                if (!parseFloats(p + 2, end, &m_TexCoords[texCoords++][0], 2))
+                    chunk.error = "bad texture coordinate: " + std::string(p, end);
+            } else if (objparsing::keyword(p, end, "vn", 2)) {
+                if (!parseFloats(p + 2, end, &m_Normals[normals++][0], 3))
+                    chunk.error = "bad normal: " + std::string(p, end);
+            } else if (objparsing::keyword(p, end, "f", 1)) {
+                if (!parseFace(p + 1, end, positions, texCoords, normals, polygon)) {
+                    chunk.error = "bad face: " + std::string(p, end);
+                    return;
+                }
+                for (size_t i = 2; i < polygon.size(); i++) {
+                    chunk.corners.push_back(polygon[0]);
+                    chunk.corners.push_back(polygon[i - 1]);
+                    chunk.corners.push_back(polygon[i]);
+                }
+            } else if (objparsing::keyword(p, end, "o", 1) || objparsing::keyword(p, end, "g", 1)) {
+                object = objparsing::restOfLine(p + 1, end);
+                chunk.segments.push_back(Segment{chunk.corners.size(), object, material});
+            } else if (objparsing::keyword(p, end, "usemtl", 6)) {
+                material = objparsing::restOfLine(p + 6, end);
+                chunk.segments.push_back(Segment{chunk.corners.size(), object, material});
+            } else if (objparsing::keyword(p, end, "mtllib", 6)) {
+                chunk.libraries.push_back(objparsing::restOfLine(p + 6, end));
+            }
+        });
+    }
+
+    static bool parseFloats(const char* p, const char* end, float* values, int count) {
+        for (int i = 0; i < count; i++) {
+            p = objparsing::parseFloat(objparsing::skipSpaces(p, end), end, values[i]);
+            if (p == nullptr)
+                return false;
+        }
+        return true;
+    }
+
+    // "v", "v/vt", "v//vn" or "v/vt/vn" per corner, negative indices count back from the current
+    // number of elements
+    bool parseFace(const char* p, const char* end, size_t positions, size_t texCoords, size_t normals,
+                   std::vector<Corner>& polygon) const {
+        polygon.clear();
+        for (p = objparsing::skipSpaces(p, end); p < end; p = objparsing::skipSpaces(p, end)) {
+            Corner corner = {-1, -1, -1};
+            long index = 0;
+            p = objparsing::parseInt(p, end, index);
+            if (p == nullptr || !resolve(index, positions, corner.position))
+                return false;
+            if (p < end && *p == '/') {
+                p++;
+                if (p < end && *p != '/') {
+                    p = objparsing::parseInt(p, end, index);
+                    if (p == nullptr || !resolve(index, texCoords, corner.texCoord))
+                        return false;
+                }
+                if (p < end && *p == '/') {
+                    p = objparsing::parseInt(p + 1, end, index);
+                    if (p == nullptr || !resolve(index, normals, corner.normal))
+                        return false;
+                }
+            }
+            polygon.push_back(corner);
+        }
+        return polygon.size() >= 3;
+    }
+
+    // positive indices may refer to elements further down the file, checked once all are known
+    bool resolve(long index, size_t current, int& resolved) const {
+        if (index > 0)
+            resolved = (int) (index - 1);
+        else if (index < 0 && (size_t) -index <= current)
+            resolved = (int) (current + index);
+        else
+            return false;
+        return true;
+    }
+
+    bool loadMaterials(const std::string& path) {
+        MappedFile file;
+        if (!file.Open(path))
+            return false;
+        Chunk whole;
+        whole.begin = file.Data();
+        whole.end = file.Data() + file.Size();
+        Material* material = nullptr;
+        forEachLine(whole, [&](const char* p, const char* end) {
+            if (objparsing::keyword(p, end, "newmtl", 6))
+                material = &m_Materials[objparsing::restOfLine(p + 6, end)];
+            else if (material == nullptr)
+                return;
+            else if (objparsing::keyword(p, end, "map_Kd", 6))
+                material->diffuse = objparsing::restOfLine(p + 6, end);
+            else if (objparsing::keyword(p, end, "map_Ks", 6))
+                material->specular = objparsing::restOfLine(p + 6, end);
+            else if (objparsing::keyword(p, end, "map_Ka", 6))
+                material->ambient = objparsing::restOfLine(p + 6, end);
+            else if (objparsing::keyword(p, end, "map_Bump", 8) || objparsing::keyword(p, end, "map_bump", 8))
+                material->bump = objparsing::restOfLine(p + 8, end);
+            else if (objparsing::keyword(p, end, "bump", 4))
+                material->bump = objparsing::restOfLine(p + 4, end);
+            else if (objparsing::keyword(p, end, "Ns", 2)) {
+                // the shader's pow() needs a positive exponent
+                float shininess;
+                if (objparsing::parseFloat(objparsing::skipSpaces(p + 2, end), end, shininess) != nullptr && shininess > 0.0f)
+                    material->shininess = shininess;
+            }
+        });
+        return true;
+    }
+
+    bool gatherMeshes() {
+        std::map<std::pair<std::string, std::string>, size_t> indexOf;
+        for (Chunk& chunk : m_Chunks) {
+            for (size_t s = 0; s < chunk.segments.size(); s++) {
+                const Segment& segment = chunk.segments[s];
+                size_t last = s + 1 < chunk.segments.size() ? chunk.segments[s + 1].firstCorner : chunk.corners.size();
+                if (last == segment.firstCorner)
+                    continue;
+                auto key = std::make_pair(segment.object, segment.material);
+                auto found = indexOf.find(key);
+                if (found == indexOf.end()) {
+                    found = indexOf.emplace(key, m_Gathered.size()).first;
+                    m_Gathered.push_back(Gathered{segment.object, segment.material, {}});
+                }
+                for (size_t i = segment.firstCorner; i < last; i++) {
+                    const Corner& corner = chunk.corners[i];
+                    if ((size_t) corner.position >= m_Positions.size() || corner.texCoord >= (int) m_TexCoords.size()
+                        || corner.normal >= (int) m_Normals.size())
+                        return false;
+                }
+                std::vector<Corner>& corners = m_Gathered[found->second].corners;
+                corners.insert(corners.end(), chunk.corners.begin() + segment.firstCorner, chunk.corners.begin() + last);
+            }
+            chunk.corners.clear();
+        }
+        m_Meshes.assign(m_Gathered.size(), ObjMesh());
+        return true;
+    }
+
+    void assemble(const Gathered& gathered, ObjMesh& mesh) {
+        RG_PROFILE_FUNCTION();
+        mesh.name = gathered.object;
+        std::unordered_map<Corner, unsigned int, CornerHash> vertexOf;
+        vertexOf.reserve(gathered.corners.size());
+        std::vector<Corner> unique;
+        bool texCoords = true;
+        bool normals = true;
+        mesh.indices.reserve(gathered.corners.size());
+        for (const Corner& corner : gathered.corners) {
+            auto inserted = vertexOf.emplace(corner, (unsigned int) unique.size());
+            if (inserted.second) {
+                unique.push_back(corner);
+                texCoords = texCoords && corner.texCoord >= 0;
+                normals = normals && corner.normal >= 0;
+            }
+            mesh.indices.push_back(inserted.first->second);
+        }
+
+        mesh.vertices.resize(unique.size());
+        for (size_t i = 0; i < unique.size(); i++) {
+            const Corner& corner = unique[i];
+            Vertex& vertex = mesh.vertices[i];
+            vertex = Vertex();
+            vertex.Position = m_Positions[corner.position];
+            if (corner.texCoord >= 0)
+                vertex.TexCoords = m_TexCoords[corner.texCoord];
+            if (corner.normal >= 0)
+                vertex.Normal = m_Normals[corner.normal];
+        }
+        if (!normals)
+            smoothNormals(mesh, unique);
+        // tangents follow the UVs as written in the file, the flip comes after like in Assimp
+        if (texCoords)
+            computeTangents(mesh);
+        for (Vertex& vertex : mesh.vertices)
+            vertex.TexCoords.y = 1.0f - vertex.TexCoords.y;
+
+        auto found = m_Materials.find(gathered.material);
+        if (found != m_Materials.end()) {
+            // same order and sampler names as Model::processMesh
+            const Material& material = found->second;
+            addTexture(mesh, material.diffuse, "texture_diffuse");
+            addTexture(mesh, material.specular, "texture_specular");
+            addTexture(mesh, material.bump, "texture_normal");
+            addTexture(mesh, material.ambient, "texture_height");
+            mesh.shininess = material.shininess;
+        }
+    }
+
+    static void addTexture(ObjMesh& mesh, const std::string& path, const char* type) {
+        if (path.empty())
+            return;
+        Texture texture;
+        texture.id = 0;
+        texture.type = type;
+        texture.path = path;
+        mesh.textures.push_back(texture);
+    }
+
+    // area weighted face normals summed over every vertex at the same position
+    static void smoothNormals(ObjMesh& mesh, const std::vector<Corner>& unique) {
+        std::unordered_map<int, glm::vec3> sums;
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            const glm::vec3& a = mesh.vertices[mesh.indices[i]].Position;
+            const glm::vec3& b = mesh.vertices[mesh.indices[i + 1]].Position;
+            const glm::vec3& c = mesh.vertices[mesh.indices[i + 2]].Position;
+            glm::vec3 normal = glm::cross(b - a, c - a);
+            for (int j = 0; j < 3; j++)
+                sums[unique[mesh.indices[i + j]].position] += normal;
+        }
+        for (size_t i = 0; i < mesh.vertices.size(); i++) {
+            glm::vec3 sum = sums[unique[i].position];
+            float length = glm::length(sum);
+            mesh.vertices[i].Normal = length > 0.0f ? sum / length : glm::vec3(0.0f, 1.0f, 0.0f);
+        }
+    }
+
+    // per triangle tangent frame from the UV gradients, summed per vertex and made orthogonal to
+    // the normal, the same construction as Assimp's CalcTangentSpace
+    static void computeTangents(ObjMesh& mesh) {
+        std::vector<glm::vec3> tangents(mesh.vertices.size(), glm::vec3(0.0f));
+        std::vector<glm::vec3> bitangents(mesh.vertices.size(), glm::vec3(0.0f));
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            const Vertex& p0 = mesh.vertices[mesh.indices[i]];
+            const Vertex& p1 = mesh.vertices[mesh.indices[i + 1]];
+            const Vertex& p2 = mesh.vertices[mesh.indices[i + 2]];
+            glm::vec3 v = p1.Position - p0.Position;
+            glm::vec3 w = p2.Position - p0.Position;
+            float sx = p1.TexCoords.x - p0.TexCoords.x, sy = p1.TexCoords.y - p0.TexCoords.y;
+            float tx = p2.TexCoords.x - p0.TexCoords.x, ty = p2.TexCoords.y - p0.TexCoords.y;
+            float direction = (tx * sy - ty * sx) < 0.0f ? -1.0f : 1.0f;
+            if (sx * ty == sy * tx) {
+                sx = 0.0f; sy = 1.0f;
+                tx = 1.0f; ty = 0.0f;
+            }
+            glm::vec3 tangent = (w * sy - v * ty) * direction;
+            glm::vec3 bitangent = (w * sx - v * tx) * direction;
+            for (int j = 0; j < 3; j++) {
+                tangents[mesh.indices[i + j]] += tangent;
+                bitangents[mesh.indices[i + j]] += bitangent;
+            }
+        }
+        for (size_t i = 0; i < mesh.vertices.size(); i++) {
+            Vertex& vertex = mesh.vertices[i];
+            vertex.Tangent = orthonormalize(tangents[i], vertex.Normal);
+            vertex.Bitangent = orthonormalize(bitangents[i], vertex.Normal);
+        }
+    }
+
+    static glm::vec3 orthonormalize(const glm::vec3& vector, const glm::vec3& normal) {
+        glm::vec3 projected = vector - normal * glm::dot(normal, vector);
+        float length = glm::length(projected);
+        return length > 1e-12f ? projected / length : glm::vec3(0.0f);
+    }
+};
+
+#endif //PROJECT_BASE_OBJLOADER_H
@@ -0,0 +1,41 @@
+#ifndef PROJECT_BASE_PROCESSMEMORY_H
+#define PROJECT_BASE_PROCESSMEMORY_H
+
+#include <cstdio>
+#include <cstring>
+
+// Resident memory of the process as the kernel counts it, read from /proc/self/status. Both values
+// stay 0 where that file does not exist.
+struct ProcessMemory {
+    size_t residentBytes = 0;       // VmRSS
+    size_t peakResidentBytes = 0;   // VmHWM, since the process started or the last ResetPeak
+
+    static ProcessMemory Current() {
+        ProcessMemory memory;
+        FILE* status = std::fopen("/proc/self/status", "r");
+        if (status == nullptr)
+            return memory;
+        char line[256];
+        while (std::fgets(line, sizeof(line), status) != nullptr) {
+            unsigned long kilobytes;
+            if (std::sscanf(line, "VmRSS: %lu kB", &kilobytes) == 1)
+                memory.residentBytes = (size_t) kilobytes * 1024;
+            else if (std::sscanf(line, "VmHWM: %lu kB", &kilobytes) == 1)
+                memory.peakResidentBytes = (size_t) kilobytes * 1024;
+        }
+        std::fclose(status);
+        return memory;
+    }
+
+    // Starts a new peak at the current resident size (Linux 4.0 and later). When this fails the
+    // peak keeps counting from the start of the process.
+    static bool ResetPeak() {
+        FILE* clearRefs = std::fopen("/proc/self/clear_refs", "w");
+        if (clearRefs == nullptr)
+            return false;
+        bool reset = std::fputs("5", clearRefs) >= 0;
+        return std::fclose(clearRefs) == 0 && reset;
+    }
+};
+
+#endif //PROJECT_BASE_PROCESSMEMORY_H
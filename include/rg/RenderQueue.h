@@ -0,0 +1,264 @@
+#ifndef PROJECT_BASE_RENDERQUEUE_H
+#define PROJECT_BASE_RENDERQUEUE_H
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <learnopengl/shader.h>
+#include <rg/GLState.h>
+#include <rg/Frustum.h>
+#include <rg/GpuProfiler.h>
+#include <rg/CpuProfiler.h>
+#include <rg/FrameArena.h>
+#include <rg/Material.h>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// passes run in this order, a pass owns the top bits of the sort key
+enum RenderPass {
+    RENDER_PASS_OPAQUE = 0,
+    RENDER_PASS_FOLIAGE,    // double sided, drawn after the opaque geometry that hides most of it
+    RENDER_PASS_SKYBOX,     // depth tested with GL_LEQUAL at the far plane, last
+    RENDER_PASS_COUNT
+};
+
+enum DrawCommand {
+    DRAW_ARRAYS = 0,
+    DRAW_ELEMENTS,          // indices of DrawItem::indexType from the bound VAO, offset by baseVertex
+    DRAW_CUSTOM             // state is applied, then the callback issues the draws itself
+};
+
+// culling results of one frame
+struct RenderQueueStats {
+    unsigned int meshesTested = 0;
+    unsigned int meshesCulled = 0;
+    unsigned long long trianglesCulled = 0;
+    unsigned int materialBinds = 0;     // items that bound their material
+    unsigned int materialsReused = 0;   // items drawn with the material the previous item bound
+};
+
+// Everything needed to issue one draw. The queue applies the state, then issues the command.
+struct DrawItem {
+    static const int MaxTextures = 4;
+
+    uint64_t key = 0;
+    Shader* shader = nullptr;
+    int modelLocation = -1;        // -1 leaves the model matrix alone
+    glm::mat4 model = glm::mat4(1.0f);
+    unsigned int vao = 0;
+    GLenum cullFace = GL_BACK;     // GL_NONE disables face culling
+    GLenum depthFunc = GL_LESS;
+
+    // binds its textures, samplers and parameters when set, instead of the texture arrays below
+    const Material* material = nullptr;
+    GLenum textureTarget = GL_TEXTURE_2D;
+    unsigned int textureCount = 0;
+    unsigned int textures[MaxTextures] = {};
+    int samplerLocations[MaxTextures] = {-1, -1, -1, -1}; // set to the unit index when >= 0
+
+    DrawCommand command = DRAW_ARRAYS;
+    GLenum primitive = GL_TRIANGLES;
+    int first = 0;
+    int count = 0;
+    GLenum indexType = GL_UNSIGNED_INT;
+    int baseVertex = 0;            // added to every index, for meshes sharing a model's buffers
+    std::function<void()> custom;
+
+    int profileSection = -1;       // GpuProfiler section the item is timed in, stamped by Submit
+};
+
+// Draw items collected over a frame and executed sorted by a 64 bit key:
+//
+//   | pass 4 | shader 12 | material or texture 16 | vao 16 | depth 16 |
+//
+// so items sharing a program, then a material (or a texture for items without one), then a VAO end
+// up next to each other and the state tracker filters the repeated binds. A run of items with the
+// same material and program binds the material once. Within equal state, opaque items go front to back.
+// Keys are sorted with an LSD radix sort, one byte per pass, skipping bytes all keys share.
+// With an Arena the draw list and the sort buffers live in frame memory, the arena has to be reset
+// between Execute and the next Begin.
+class RenderQueue {
+public:
+    // when off, IsVisible only counts
+    bool CullingEnabled = true;
+    // when set, Execute times the items per profile section
+    GpuProfiler* Profiler = nullptr;
+    // when set, the lists are allocated from it every frame instead of keeping heap capacity
+    FrameArena* Arena = nullptr;
+
+    // camera used for culling and for the depth part of the key
+    void Begin(const Frustum& frustum, const glm::vec3& cameraPosition, float farPlane) {
+        if (Arena != nullptr) {
+            // Execute emptied the lists, their memory went with the arena reset
+            m_Items = FrameVector<DrawItem>(FrameAllocator<DrawItem>(Arena));
+            m_Sorted = FrameVector<SortEntry>(FrameAllocator<SortEntry>(Arena));
+            m_Scratch = FrameVector<SortEntry>(FrameAllocator<SortEntry>(Arena));
+            m_Items.reserve(m_LastSize);
+        }
+        m_Items.clear();
+        m_Frustum = frustum;
+        m_CameraPosition = cameraPosition;
+        m_FarPlane = farPlane;
+        m_Stats = RenderQueueStats();
+        m_ProfileSection = -1;
+    }
+
+    // items submitted from now on are timed in this GpuProfiler section
+    void SetProfileSection(int section) { m_ProfileSection = section; }
+
+    // Tests local space bounds placed with a model matrix against the frustum, the bounding sphere
+    // first and the world space box around the AABB only if the sphere intersects.
+    bool IsVisible(const glm::mat4& model, const glm::vec3& min, const glm::vec3& max,
+                   const glm::vec3& center, float radius, unsigned int triangles) {
+        m_Stats.meshesTested++;
+        if (!CullingEnabled)
+            return true;
+
+        glm::vec3 worldCenter = glm::vec3(model * glm::vec4(center, 1.0f));
+        float scale = glm::max(glm::length(glm::vec3(model[0])),
+                               glm::max(glm::length(glm::vec3(model[1])), glm::length(glm::vec3(model[2]))));
+        bool visible = m_Frustum.IntersectsSphere(worldCenter, radius * scale);
+        if (visible) {
+            glm::vec3 worldMin, worldMax;
+            TransformAABB(model, min, max, worldMin, worldMax);
+            visible = m_Frustum.IntersectsAABB(worldMin, worldMax);
+        }
+        if (!visible) {
+            m_Stats.meshesCulled++;
+            m_Stats.trianglesCulled += triangles;
+        }
+        return visible;
+    }
+
+    // fills in the key from the item's state and its distance to the camera, at the model's origin
+    void Submit(RenderPass pass, DrawItem item) {
+        float distance = glm::length(glm::vec3(item.model[3]) - m_CameraPosition);
+        item.profileSection = m_ProfileSection;
+        item.key = MakeKey(pass, item.shader->ID, stateKey(item), item.vao, distance / m_FarPlane);
+        m_Items.push_back(std::move(item));
+    }
+
+    static uint64_t MakeKey(unsigned int pass, unsigned int program, unsigned int texture, unsigned int vao, float depth) {
+        uint64_t depthBits = (uint64_t) (glm::clamp(depth, 0.0f, 1.0f) * 65535.0f);
+        return ((uint64_t) (pass & 0xf) << 60)
+               | ((uint64_t) (program & 0xfff) << 48)
+               | ((uint64_t) (texture & 0xffff) << 32)
+               | ((uint64_t) (vao & 0xffff) << 16)
+               | depthBits;
+    }
+
+    void Execute() {
+        RG_PROFILE_FUNCTION();
+        sort();
+        GLState& state = GLState::Get();
+        const Material* boundMaterial = nullptr;
+        unsigned int boundProgram = 0;
+        for (const SortEntry& entry : m_Sorted) {
+            const DrawItem& item = m_Items[entry.item];
+            if (Profiler != nullptr && item.profileSection >= 0)
+                Profiler->Begin(item.profileSection);
+            state.SetCapability(GL_CULL_FACE, item.cullFace != GL_NONE);
+            if (item.cullFace != GL_NONE)
+                state.CullFace(item.cullFace);
+            state.DepthFunc(item.depthFunc);
+            item.shader->use();
+            if (item.modelLocation >= 0)
+                item.shader->setMat4(item.modelLocation, item.model);
+            if (item.material != nullptr) {
+                if (item.material != boundMaterial || item.shader->ID != boundProgram) {
+                    item.material->Bind(*item.shader);
+                    m_Stats.materialBinds++;
+                } else {
+                    m_Stats.materialsReused++;
+                }
+            }
+            for (unsigned int unit = 0; unit < item.textureCount; unit++) {
+                if (item.samplerLocations[unit] >= 0)
+                    item.shader->setInt(item.samplerLocations[unit], unit);
+                state.BindTexture(unit, item.textureTarget, item.textures[unit]);
+            }
+            // anything else may have changed the units or the uniforms the material set
+            boundMaterial = item.command != DRAW_CUSTOM && item.textureCount == 0 ? item.material : nullptr;
+            boundProgram = item.shader->ID;
+
+            switch (item.command) {
+                case DRAW_ARRAYS:
+                    state.BindVertexArray(item.vao);
+                    glDrawArrays(item.primitive, item.first, item.count);
+                    break;
+                case DRAW_ELEMENTS:
+                    state.BindVertexArray(item.vao);
+                    glDrawElementsBaseVertex(item.primitive, item.count, item.indexType,
+                                             (void*) (item.first * (item.indexType == GL_UNSIGNED_SHORT ? sizeof(unsigned short) : sizeof(unsigned int))),
+                                             item.baseVertex);
+                    break;
+                case DRAW_CUSTOM:
+                    item.custom();
+                    break;
+            }
+        }
+        if (Profiler != nullptr)
+            Profiler->End();
+        m_LastSize = (unsigned int) m_Items.size();
+        // the items hold std::functions, destroy them while their memory is still valid
+        m_Items.clear();
+        m_LastStats = m_Stats;
+    }
+
+    // number of items executed last frame
+    unsigned int LastSize() const { return m_LastSize; }
+    const RenderQueueStats& LastStats() const { return m_LastStats; }
+
+private:
+    struct SortEntry {
+        uint64_t key;
+        unsigned int item;
+    };
+
+    FrameVector<DrawItem> m_Items;
+    FrameVector<SortEntry> m_Sorted;
+    FrameVector<SortEntry> m_Scratch;
+    Frustum m_Frustum;
+    RenderQueueStats m_Stats;
+    RenderQueueStats m_LastStats;
+    int m_ProfileSection = -1;
+    glm::vec3 m_CameraPosition = glm::vec3(0.0f);
+    float m_FarPlane = 1.0f;
+    unsigned int m_LastSize = 0;
+
+    // materials and bare textures get separate halves of the key field
+    static unsigned int stateKey(const DrawItem& item) {
+        if (item.material != nullptr)
+            return 0x8000 | (item.material->Id() & 0x7fff);
+        return item.textureCount > 0 ? item.textures[0] & 0x7fff : 0;
+    }
+
+    void sort() {
+        size_t n = m_Items.size();
+        m_Sorted.resize(n);
+        m_Scratch.resize(n);
+        for (size_t i = 0; i < n; i++)
+            m_Sorted[i] = SortEntry{m_Items[i].key, (unsigned int) i};
+
+        for (int shift = 0; shift < 64; shift += 8) {
+            size_t counts[256] = {};
+            for (const SortEntry& entry : m_Sorted)
+                counts[(entry.key >> shift) & 0xff]++;
+            // every key has the same byte here, the order would not change
+            if (n == 0 || counts[(m_Sorted[0].key >> shift) & 0xff] == n)
+                continue;
+
+            size_t offset = 0;
+            for (size_t& count : counts) {
+                size_t c = count;
+                count = offset;
+                offset += c;
+            }
+            for (const SortEntry& entry : m_Sorted)
+                m_Scratch[counts[(entry.key >> shift) & 0xff]++] = entry;
+            m_Sorted.swap(m_Scratch);
+        }
+    }
+};
+
+#endif //PROJECT_BASE_RENDERQUEUE_H
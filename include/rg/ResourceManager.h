@@ -0,0 +1,217 @@
+#ifndef PROJECT_BASE_RESOURCEMANAGER_H
+#define PROJECT_BASE_RESOURCEMANAGER_H
+
+#include <glad/glad.h>
+#include <learnopengl/shader.h>
+#include <rg/MeshCache.h>
+#include <rg/TextureStreamer.h>
+#include <algorithm>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class Model;
+
+// A shared resource. It is released when its last handle goes away, the manager only remembers it.
+template<typename T>
+using ResourceHandle = std::shared_ptr<T>;
+
+// GL texture name, deleted with its last handle. A streamed texture is handed back to its
+// streamer, which has to outlive it, so an upload still in flight is dropped.
+struct TextureResource {
+    unsigned int id;
+    TextureStreamer* streamer;
+
+    explicit TextureResource(unsigned int id, TextureStreamer* streamer = nullptr) : id(id), streamer(streamer) {}
+    ~TextureResource() {
+        if (id == 0)
+            return;
+        if (streamer != nullptr)
+            streamer->Release(id);
+        else
+            glDeleteTextures(1, &id);
+    }
+
+    TextureResource(const TextureResource&) = delete;
+    TextureResource& operator=(const TextureResource&) = delete;
+};
+
+struct ResourceCacheStats {
+    unsigned int pathHits = 0;      // found under the same normalized path
+    unsigned int contentHits = 0;   // another path with the same file contents
+    unsigned int loads = 0;
+};
+
+// Live resources of one type, found by the normalized paths of their source files or by the
+// contents of those files, both in hashed maps. A path that was seen before is found without
+// touching the file; a new path costs one read of the files to hash them, so a copy of an asset
+// under another name is not loaded twice. The variant string separates resources loaded from the
+// same files with different settings. A file that changes while its resource is alive is not
+// noticed. Entries of released resources are dropped when a lookup runs into them, and all of them
+// whenever the maps have doubled since the last sweep. Not thread safe, meant for the GL thread.
+template<typename T>
+class ResourceCache {
+public:
+    // without matchContents resources are found by path only, for resources that depend on more than
+    // the bytes of their files, e.g. a model whose materials and textures resolve next to it
+    explicit ResourceCache(bool matchContents = true) : m_MatchContents(matchContents) {}
+    ResourceCache(const ResourceCache&) = delete;
+    ResourceCache& operator=(const ResourceCache&) = delete;
+
+    // the live resource made from these files with this variant, or load() called to make it.
+    // load returns a ResourceHandle<T>, an empty handle is returned as is and not remembered.
+    template<typename Load>
+    ResourceHandle<T> Acquire(const std::vector<std::string>& paths, const std::string& variant, Load load) {
+        std::string pathKey;
+        for (const std::string& path : paths)
+            pathKey += NormalizePath(path) + '\n';
+        pathKey += variant;
+        auto byPath = m_ByPath.find(pathKey);
+        if (byPath != m_ByPath.end()) {
+            if (ResourceHandle<T> resource = byPath->second.lock()) {
+                m_Stats.pathHits++;
+                return resource;
+            }
+            m_ByPath.erase(byPath);
+        }
+
+        std::string contentKey;
+        if (m_MatchContents && hashFiles(paths, contentKey)) {
+            contentKey += variant;
+            auto byContent = m_ByContent.find(contentKey);
+            if (byContent != m_ByContent.end()) {
+                if (ResourceHandle<T> resource = byContent->second.lock()) {
+                    m_Stats.contentHits++;
+                    m_ByPath[pathKey] = resource;
+                    return resource;
+                }
+                m_ByContent.erase(byContent);
+            }
+        }
+
+        ResourceHandle<T> resource = load();
+        m_Stats.loads++;
+        if (!resource)
+            return resource;
+        m_ByPath[pathKey] = resource;
+        if (!contentKey.empty())
+            m_ByContent[contentKey] = resource;
+        if (m_ByPath.size() + m_ByContent.size() > 2 * m_SweptSize)
+            sweep();
+        return resource;
+    }
+
+    const ResourceCacheStats& Stats() const { return m_Stats; }
+
+    // absolute path with symbolic links, "." and ".." resolved, the path itself when it does not exist
+    static std::string NormalizePath(const std::string& path) {
+        char resolved[PATH_MAX];
+        if (realpath(path.c_str(), resolved) == nullptr)
+            return path;
+        return resolved;
+    }
+
+private:
+    std::unordered_map<std::string, std::weak_ptr<T>> m_ByPath;
+    std::unordered_map<std::string, std::weak_ptr<T>> m_ByContent;
+    ResourceCacheStats m_Stats;
+    bool m_MatchContents;
+    size_t m_SweptSize = 8; // entries left by the last sweep, at least a few so small caches are not swept every time
+
+    // FNV-1a of every file, as raw bytes in front of the variant
+    static bool hashFiles(const std::vector<std::string>& paths, std::string& key) {
+        for (const std::string& path : paths) {
+            uint64_t hash;
+            if (!MeshCache::HashFile(path, hash)) {
+                key.clear();
+                return false;
+            }
+            key.append(reinterpret_cast<const char*>(&hash), sizeof(hash));
+        }
+        return true;
+    }
+
+    // forgets the entries of released resources, amortized over the insertions that doubled the maps
+    void sweep() {
+        prune(m_ByPath);
+        prune(m_ByContent);
+        m_SweptSize = std::max<size_t>(m_ByPath.size() + m_ByContent.size(), 8);
+    }
+
+    static void prune(std::unordered_map<std::string, std::weak_ptr<T>>& entries) {
+        for (auto it = entries.begin(); it != entries.end();) {
+            if (it->second.expired())
+                it = entries.erase(it);
+            else
+                ++it;
+        }
+    }
+};
+
+// Process wide caches of textures, shader programs and models, so every user of an asset shares
+// one copy of it on the GPU. Models are loaded through Model::Load and found by path only, two
+// copies of an .obj in different folders can use different materials and textures. Meshes are
+// reached through their model (Model::MeshHandle).
+class ResourceManager {
+public:
+    static ResourceManager& Get() {
+        static ResourceManager manager;
+        return manager;
+    }
+
+    ResourceManager(const ResourceManager&) = delete;
+    ResourceManager& operator=(const ResourceManager&) = delete;
+
+    ResourceCache<TextureResource>& Textures() { return m_Textures; }
+    ResourceCache<Shader>& Shaders() { return m_Shaders; }
+    ResourceCache<Model>& Models() { return m_Models; }
+
+    ResourceHandle<TextureResource> LoadTexture(const std::string& path, TextureStreamer& streamer,
+                                                const StreamedTextureSettings& settings = StreamedTextureSettings()) {
+        return m_Textures.Acquire({path}, TextureVariant(GL_TEXTURE_2D, settings), [&]() {
+            return std::make_shared<TextureResource>(streamer.Request(path, settings), &streamer);
+        });
+    }
+
+    ResourceHandle<TextureResource> LoadCubemap(const std::vector<std::string>& faces, TextureStreamer& streamer,
+                                                const StreamedTextureSettings& settings = StreamedTextureSettings()) {
+        return m_Textures.Acquire(faces, TextureVariant(GL_TEXTURE_CUBE_MAP, settings), [&]() {
+            return std::make_shared<TextureResource>(streamer.RequestCubemap(faces, settings), &streamer);
+        });
+    }
+
+    // the program is deleted with its last handle
+    ResourceHandle<Shader> LoadShader(const char* vertexPath, const char* fragmentPath, const char* geometryPath = nullptr) {
+        std::vector<std::string> paths{vertexPath, fragmentPath};
+        if (geometryPath != nullptr)
+            paths.push_back(geometryPath);
+        return m_Shaders.Acquire(paths, "", [&]() {
+            return ResourceHandle<Shader>(new Shader(vertexPath, fragmentPath, geometryPath), [](Shader* shader) {
+                glDeleteProgram(shader->ID);
+                delete shader;
+            });
+        });
+    }
+
+    // textures made from the same files with these settings look the same
+    static std::string TextureVariant(GLenum target, const StreamedTextureSettings& settings) {
+        char variant[128];
+        std::snprintf(variant, sizeof(variant), "%x %u %u %u %u %x %x %d %d", target,
+                      settings.placeholder[0], settings.placeholder[1], settings.placeholder[2], settings.placeholder[3],
+                      settings.wrapS, settings.wrapT, settings.clampTransparent, settings.mipmaps);
+        return variant;
+    }
+
+private:
+    ResourceCache<TextureResource> m_Textures;
+    ResourceCache<Shader> m_Shaders;
+    ResourceCache<Model> m_Models{false};
+
+    ResourceManager() = default;
+};
+
+#endif //PROJECT_BASE_RESOURCEMANAGER_H
@@ -13,8 +13,47 @@
 #include <rg/Error.h>
 #include <common.h>
 #include <glm/glm.hpp>
+#include <unordered_map>
+#include <vector>
+
+// an active uniform as reported by the program after linking
+struct UniformInfo {
+    int location;
+    GLenum type;
+    int size;
+};
+
 class Shader {
     unsigned int m_Id;
+    std::unordered_map<std::string, UniformInfo> m_Uniforms;
+
+    // enumerates the active uniforms once after linking. Arrays are reported as "name[0]",
+    // they are also stored under "name" and every "name[i]".
+    void reflectUniforms() {
+        GLint count = 0, maxLength = 0;
+        glGetProgramiv(m_Id, GL_ACTIVE_UNIFORMS, &count);
+        glGetProgramiv(m_Id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+        std::vector<GLchar> buffer(maxLength > 0 ? maxLength : 1);
+        for (GLint i = 0; i < count; ++i) {
+            GLsizei length = 0;
+            UniformInfo info;
+            glGetActiveUniform(m_Id, (GLuint)i, maxLength, &length, &info.size, &info.type, buffer.data());
+            std::string name(buffer.data(), length);
+            info.location = glGetUniformLocation(m_Id, name.c_str());
+            if (info.location < 0) { // uniforms inside uniform blocks have no location
+                continue;
+            }
+            m_Uniforms[name] = info;
+            if (name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0) {
+                std::string base = name.substr(0, name.size() - 3);
+                m_Uniforms[base] = info;
+                for (int element = 1; element < info.size; ++element) {
+                    std::string elementName = base + "[" + std::to_string(element) + "]";
+                    m_Uniforms[elementName] = {glGetUniformLocation(m_Id, elementName.c_str()), info.type, 1};
+                }
+            }
+        }
+    }
 public:
     Shader(std::string vertexShaderPath, std::string fragmentShaderPath) {
         appendShaderFolderIfNotPresent(vertexShaderPath);
@@ -65,6 +104,7 @@ public:
         glDeleteShader(vertexShader);
         glDeleteShader(fragmentShader);
         m_Id = shaderProgram;
+        reflectUniforms();
     }
 
     // activate the shader
@@ -73,63 +113,104 @@ public:
     {
         glUseProgram(m_Id);
     }
+    // uniform locations
+    // ------------------------------------------------------------------------
+    // looks the name up in the table built after linking, -1 if the program has no such
+    // active uniform. Hot code should resolve its locations once and keep them.
+    int getUniformLocation(const std::string &name) const
+    {
+        auto it = m_Uniforms.find(name);
+        return it != m_Uniforms.end() ? it->second.location : -1;
+    }
+    const std::unordered_map<std::string, UniformInfo>& activeUniforms() const
+    {
+        return m_Uniforms;
+    }
     // utility uniform functions
     // ------------------------------------------------------------------------
     void setBool(const std::string &name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), (int)value);
+        setBool(getUniformLocation(name), value);
+    }
+    void setBool(int location, bool value) const
+    {
+        glUniform1i(location, (int)value);
     }
     // ------------------------------------------------------------------------
     void setInt(const std::string &name, int value) const
     {
-        glUniform1i(glGetUniformLocation(m_Id, name.c_str()), value);
+        setInt(getUniformLocation(name), value);
+    }
+    void setInt(int location, int value) const
+    {
+        glUniform1i(location, value);
     }
     // ------------------------------------------------------------------------
     void setFloat(const std::string &name, float value) const
     {
-        glUniform1f(glGetUniformLocation(m_Id, name.c_str()), value);
+        setFloat(getUniformLocation(name), value);
+    }
+    void setFloat(int location, float value) const
+    {
+        glUniform1f(location, value);
     }
     // ------------------------------------------------------------------------
     void setVec2(const std::string &name, const glm::vec2 &value) const
     {
-        glUniform2fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        setVec2(getUniformLocation(name), value);
+    }
+    void setVec2(int location, const glm::vec2 &value) const
+    {
+        glUniform2fv(location, 1, &value[0]);
     }
     void setVec2(const std::string &name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(m_Id, name.c_str()), x, y);
+        glUniform2f(getUniformLocation(name), x, y);
     }
     // ------------------------------------------------------------------------
     void setVec3(const std::string &name, const glm::vec3 &value) const
     {
-        glUniform3fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        setVec3(getUniformLocation(name), value);
+    }
+    void setVec3(int location, const glm::vec3 &value) const
+    {
+        glUniform3fv(location, 1, &value[0]);
     }
     void setVec3(const std::string &name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(m_Id, name.c_str()), x, y, z);
+        glUniform3f(getUniformLocation(name), x, y, z);
     }
     // ------------------------------------------------------------------------
     void setVec4(const std::string &name, const glm::vec4 &value) const
     {
-        glUniform4fv(glGetUniformLocation(m_Id, name.c_str()), 1, &value[0]);
+        setVec4(getUniformLocation(name), value);
+    }
+    void setVec4(int location, const glm::vec4 &value) const
+    {
+        glUniform4fv(location, 1, &value[0]);
     }
     void setVec4(const std::string &name, float x, float y, float z, float w)
     {
-        glUniform4f(glGetUniformLocation(m_Id, name.c_str()), x, y, z, w);
+        glUniform4f(getUniformLocation(name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
     void setMat2(const std::string &name, const glm::mat2 &mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat3(const std::string &name, const glm::mat3 &mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(getUniformLocation(name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
     void setMat4(const std::string &name, const glm::mat4 &mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(m_Id, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        setMat4(getUniformLocation(name), mat);
+    }
+    void setMat4(int location, const glm::mat4 &mat) const
+    {
+        glUniformMatrix4fv(location, 1, GL_FALSE, &mat[0][0]);
     }
     void deleteProgram() {
         glDeleteProgram(m_Id);
@@ -0,0 +1,173 @@
+#ifndef PROJECT_BASE_TEXTURECOOKER_H
+#define PROJECT_BASE_TEXTURECOOKER_H
+
+#include <stb_image.h>
+#include <rg/BlockCompression.h>
+#include <rg/CpuProfiler.h>
+#include <rg/JobSystem.h>
+#include <rg/Ktx.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <sys/stat.h>
+
+struct CookResult {
+    std::string path;
+    bool ok = false;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    BlockFormat format = BLOCK_BC1;
+    unsigned int levels = 0;
+    size_t uncompressedBytes = 0;   // the same mip chain uploaded from the source image
+    size_t cookedBytes = 0;
+};
+
+// the cooked texture lives next to its source, like the mesh cache
+inline std::string CookedTexturePath(const std::string& sourcePath) { return sourcePath + ".ktx"; }
+
+// a cooked texture older than its source is ignored until it is cooked again
+inline bool CookedTextureIsCurrent(const std::string& sourcePath) {
+    struct stat source, cooked;
+    if (stat(sourcePath.c_str(), &source) != 0 || stat(CookedTexturePath(sourcePath).c_str(), &cooked) != 0)
+        return false;
+    return cooked.st_mtime >= source.st_mtime;
+}
+
+// bytes of a full mip chain with the given bytes per texel
+inline size_t MipChainBytes(int width, int height, int bytesPerTexel, bool mipmaps = true) {
+    size_t bytes = 0;
+    for (;;) {
+        bytes += (size_t) width * height * bytesPerTexel;
+        if (!mipmaps || (width == 1 && height == 1))
+            return bytes;
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+}
+
+// 2x2 box filter, odd edges reuse the last row or column
+inline std::vector<unsigned char> DownsampleRgba(const std::vector<unsigned char>& source, int width, int height, int& nextWidth, int& nextHeight) {
+    nextWidth = std::max(1, width / 2);
+    nextHeight = std::max(1, height / 2);
+    std::vector<unsigned char> result((size_t) nextWidth * nextHeight * 4);
+    for (int y = 0; y < nextHeight; y++) {
+        int y0 = std::min(2 * y, height - 1), y1 = std::min(2 * y + 1, height - 1);
+        for (int x = 0; x < nextWidth; x++) {
+            int x0 = std::min(2 * x, width - 1), x1 = std::min(2 * x + 1, width - 1);
+            for (int c = 0; c < 4; c++) {
+                int sum = source[4 * ((size_t) y0 * width + x0) + c] + source[4 * ((size_t) y0 * width + x1) + c]
+                          + source[4 * ((size_t) y1 * width + x0) + c] + source[4 * ((size_t) y1 * width + x1) + c];
+                result[4 * ((size_t) y * nextWidth + x) + c] = (unsigned char) ((sum + 2) / 4);
+            }
+        }
+    }
+    return result;
+}
+
+// Converts one image to a block compressed KTX with its whole mip chain. Grey opaque images go to
+// RGTC1 (sampled with a red swizzle), other opaque images to BC1 and images with alpha to BC3.
+inline CookResult CookTexture(const std::string& sourcePath) {
+    RG_PROFILE_FUNCTION();
+    CookResult result;
+    result.path = sourcePath;
+    int width, height, channels;
+    unsigned char* pixels = stbi_load(sourcePath.c_str(), &width, &height, &channels, 4);
+    if (pixels == nullptr)
+        return result;
+    std::vector<unsigned char> level(pixels, pixels + (size_t) width * height * 4);
+    stbi_image_free(pixels);
+
+    bool opaque = true, grey = true;
+    for (size_t i = 0; i < level.size(); i += 4) {
+        opaque = opaque && level[i + 3] == 255;
+        grey = grey && level[i] == level[i + 1] && level[i] == level[i + 2];
+    }
+    BlockFormat format = !opaque ? BLOCK_BC3 : grey ? BLOCK_RGTC1 : BLOCK_BC1;
+
+    KtxTexture texture;
+    texture.internalFormat = BlockFormatInternalFormat(format);
+    texture.baseInternalFormat = format == BLOCK_BC3 ? GL_RGBA : format == BLOCK_BC1 ? GL_RGB : GL_RED;
+    texture.width = (uint32_t) width;
+    texture.height = (uint32_t) height;
+    texture.sourceChannels = (uint32_t) channels;
+    int levelWidth = width, levelHeight = height;
+    for (;;) {
+        std::vector<unsigned char> blocks = CompressImage(level.data(), levelWidth, levelHeight, format);
+        KtxImage image = {texture.levels, 0, (uint32_t) levelWidth, (uint32_t) levelHeight, texture.data.size(), (uint32_t) blocks.size()};
+        texture.images.push_back(image);
+        texture.data.insert(texture.data.end(), blocks.begin(), blocks.end());
+        texture.levels++;
+        if (levelWidth == 1 && levelHeight == 1)
+            break;
+        level = DownsampleRgba(level, levelWidth, levelHeight, levelWidth, levelHeight);
+    }
+    if (!WriteKtx(CookedTexturePath(sourcePath), texture))
+        return result;
+
+    result.ok = true;
+    result.width = width;
+    result.height = height;
+    result.channels = channels;
+    result.format = format;
+    result.levels = texture.levels;
+    result.uncompressedBytes = MipChainBytes(width, height, channels);
+    result.cookedBytes = texture.data.size();
+    return result;
+}
+
+inline void FindTextureSources(const std::string& directory, std::vector<std::string>& paths) {
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr)
+        return;
+    while (dirent* entry = readdir(dir)) {
+        std::string name = entry->d_name;
+        if (name == "." || name == "..")
+            continue;
+        std::string path = directory + "/" + name;
+        struct stat info;
+        if (stat(path.c_str(), &info) != 0)
+            continue;
+        if (S_ISDIR(info.st_mode)) {
+            FindTextureSources(path, paths);
+            continue;
+        }
+        std::string extension = name.substr(std::min(name.size(), name.rfind('.') + 1));
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+        if (extension == "png" || extension == "jpg" || extension == "jpeg" || extension == "tga" || extension == "bmp")
+            paths.push_back(path);
+    }
+    closedir(dir);
+}
+
+// Cooks every image under directory, one job per image, and prints the memory each one saves.
+inline std::vector<CookResult> CookTextures(const std::string& directory, JobSystem& jobs) {
+    std::vector<std::string> paths;
+    FindTextureSources(directory, paths);
+    std::sort(paths.begin(), paths.end());
+    std::vector<CookResult> results(paths.size());
+    jobs.ParallelFor(0, paths.size(), 1, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+            results[i] = CookTexture(paths[i]);
+    });
+
+    size_t uncompressed = 0, cooked = 0;
+    for (const CookResult& result : results) {
+        if (!result.ok) {
+            printf("%s: failed to cook\n", result.path.c_str());
+            continue;
+        }
+        printf("%s: %dx%d, %d channels -> %s, %u levels, %zu KB -> %zu KB (%.1fx)\n", result.path.c_str(),
+               result.width, result.height, result.channels, BlockFormatName(result.format), result.levels,
+               result.uncompressedBytes / 1024, result.cookedBytes / 1024, (double) result.uncompressedBytes / result.cookedBytes);
+        uncompressed += result.uncompressedBytes;
+        cooked += result.cookedBytes;
+    }
+    printf("%zu textures, %zu KB -> %zu KB, %zu KB saved\n", results.size(), uncompressed / 1024, cooked / 1024, (uncompressed - cooked) / 1024);
+    return results;
+}
+
+#endif //PROJECT_BASE_TEXTURECOOKER_H
@@ -0,0 +1,382 @@
+#ifndef PROJECT_BASE_TEXTURESTREAMER_H
+#define PROJECT_BASE_TEXTURESTREAMER_H
+
+#include <glad/glad.h>
+#include <stb_image.h>
+#include <rg/CpuProfiler.h>
+#include <rg/GLState.h>
+#include <rg/JobSystem.h>
+#include <rg/Ktx.h>
+#include <rg/TextureCooker.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Unbounded multi producer, single consumer queue of intrusive nodes (T::next). Push is a CAS on
+// the head of a list, the consumer takes the whole list at once and restores the push order.
+template<typename T>
+class MpscQueue {
+public:
+    void Push(T* node) {
+        T* head = m_Head.load(std::memory_order_relaxed);
+        do {
+            node->next = head;
+        } while (!m_Head.compare_exchange_weak(head, node, std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    // appends everything pushed so far to out, oldest first
+    void PopAll(std::deque<T*>& out) {
+        T* node = m_Head.exchange(nullptr, std::memory_order_acquire);
+        size_t first = out.size();
+        for (; node != nullptr; node = node->next)
+            out.push_back(node);
+        std::reverse(out.begin() + first, out.end());
+    }
+
+private:
+    std::atomic<T*> m_Head{nullptr};
+};
+
+struct StreamedTextureSettings {
+    unsigned char placeholder[4] = {128, 128, 128, 255};
+    GLenum wrapS = GL_REPEAT;
+    GLenum wrapT = GL_REPEAT;       // also used for R on cubemaps
+    bool clampTransparent = false;  // images with alpha clamp to edge whatever wrapS/T say
+    bool mipmaps = true;
+};
+
+// what one texture occupies on the GPU against the same texture uploaded uncompressed
+struct TextureMemoryRecord {
+    std::string path;
+    bool cooked;
+    GLenum internalFormat;
+    unsigned long long uncompressedBytes;
+    unsigned long long gpuBytes;
+};
+
+struct TextureStreamerStats {
+    unsigned int uploads = 0;
+    unsigned long long bytes = 0;
+    double ms = 0.0;
+};
+
+// Loads textures without blocking the GL thread. A request creates the texture object at once
+// with a 1x1 placeholder, so its id can be used right away, and decodes the file on the job
+// system. Decoded images come back through an MpscQueue; Update, called once per frame on the GL
+// thread, uploads them through a pixel buffer object until the frame's time budget is spent and
+// replaces the placeholder in the same texture object. A cubemap is uploaded as a whole, so it is
+// never sampled with faces of different sizes.
+//
+// A current cooked texture next to the source (see TextureCooker.h) is loaded instead of the
+// image: block compressed, with its mip chain, in immutable storage when glTexStorage2D exists.
+// Without one, or without S3TC support, the image is decoded with stb and mipmapped on the GPU.
+//
+// stb_image 2.14 keeps its failure reason in a global, concurrent decodes only race on it when
+// they fail; the vertical flip setting must not change while textures are streaming.
+class TextureStreamer {
+public:
+    // loadProc resolves glTexStorage2D on contexts older than 4.2 that have ARB_texture_storage
+    explicit TextureStreamer(JobSystem& jobs, GLADloadproc loadProc = nullptr) : m_Jobs(jobs) {
+        glGenBuffers(1, &m_Pbo);
+        m_S3tcSupported = GLState::HasExtension("GL_EXT_texture_compression_s3tc");
+        bool storage = GLVersion.major > 4 || (GLVersion.major == 4 && GLVersion.minor >= 2) || GLState::HasExtension("GL_ARB_texture_storage");
+        if (storage && loadProc != nullptr)
+            m_TexStorage2D = reinterpret_cast<TexStorage2DProc>(loadProc("glTexStorage2D"));
+    }
+
+    ~TextureStreamer() {
+        m_Jobs.Wait(m_Decoding);
+        m_Ready.PopAll(m_Uploads);
+        for (Image* image : m_Uploads)
+            release(image);
+        glDeleteBuffers(1, &m_Pbo);
+    }
+
+    TextureStreamer(const TextureStreamer&) = delete;
+    TextureStreamer& operator=(const TextureStreamer&) = delete;
+
+    unsigned int Request(const std::string& path, const StreamedTextureSettings& settings = StreamedTextureSettings()) {
+        return request(GL_TEXTURE_2D, std::vector<std::string>{path}, settings);
+    }
+
+    // faces in GL_TEXTURE_CUBE_MAP_POSITIVE_X + i order
+    unsigned int RequestCubemap(const std::vector<std::string>& faces, const StreamedTextureSettings& settings = StreamedTextureSettings()) {
+        return request(GL_TEXTURE_CUBE_MAP, faces, settings);
+    }
+
+    // uploads decoded images for up to budgetMs, at least one per call so streaming always advances
+    void Update(double budgetMs) {
+        RG_PROFILE_FUNCTION();
+        auto start = std::chrono::steady_clock::now();
+        m_Ready.PopAll(m_Uploads);
+        m_Stats = TextureStreamerStats();
+        while (!m_Uploads.empty()) {
+            double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            if (m_Stats.uploads > 0 && elapsed >= budgetMs)
+                break;
+            Image* image = m_Uploads.front();
+            m_Uploads.pop_front();
+            // a released texture's name may already belong to a newer request
+            if (!image->cancelled) {
+                m_InFlight.erase(image->texture);
+                upload(*image);
+            }
+            release(image);
+            m_Pending--;
+        }
+        m_Stats.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    // Deletes a texture this streamer created. When its image is still being decoded or waiting
+    // for upload, the image is dropped instead of uploaded into the deleted name.
+    void Release(unsigned int texture) {
+        auto found = m_InFlight.find(texture);
+        if (found != m_InFlight.end()) {
+            found->second->cancelled = true;
+            m_InFlight.erase(found);
+        }
+        glDeleteTextures(1, &texture);
+    }
+
+    // blocks until every requested texture is uploaded
+    void Finish() {
+        m_Jobs.Wait(m_Decoding);
+        while (m_Pending > 0)
+            Update(1e30);
+    }
+
+    // requested textures still showing their placeholder
+    unsigned int Pending() const { return m_Pending; }
+    const TextureStreamerStats& LastFrameStats() const { return m_Stats; }
+    // one record per uploaded texture, in upload order
+    const std::vector<TextureMemoryRecord>& MemoryRecords() const { return m_Memory; }
+    bool ImmutableStorage() const { return m_TexStorage2D != nullptr; }
+
+private:
+    struct Image {
+        Image* next = nullptr;
+        unsigned int texture = 0;
+        GLenum target = GL_TEXTURE_2D;
+        StreamedTextureSettings settings;
+        std::vector<std::string> paths;
+        std::vector<unsigned char*> pixels;
+        std::vector<KtxTexture> cooked;     // one per face, replaces pixels when present
+        int width = 0, height = 0, channels = 0;
+        bool failed = false;
+        bool cancelled = false;             // set by Release, GL thread only
+    };
+
+    // one level of one face, data is an offset into the PBO
+    struct Surface {
+        GLenum target;
+        int level;
+        int width, height;
+        const unsigned char* source;
+        size_t size;
+    };
+
+    typedef void (APIENTRYP TexStorage2DProc)(GLenum target, GLsizei levels, GLenum internalFormat, GLsizei width, GLsizei height);
+
+    JobSystem& m_Jobs;
+    JobCounter m_Decoding;
+    MpscQueue<Image> m_Ready;
+    std::deque<Image*> m_Uploads;   // GL thread only
+    std::unordered_map<unsigned int, Image*> m_InFlight;    // texture name to its image until upload, GL thread only
+    unsigned int m_Pending = 0;
+    unsigned int m_Pbo = 0;
+    TextureStreamerStats m_Stats;
+    std::vector<TextureMemoryRecord> m_Memory;
+    bool m_S3tcSupported = false;
+    TexStorage2DProc m_TexStorage2D = nullptr;
+
+    static GLenum faceTarget(const Image& image, size_t face) {
+        return image.target == GL_TEXTURE_CUBE_MAP ? (GLenum) (GL_TEXTURE_CUBE_MAP_POSITIVE_X + face) : image.target;
+    }
+
+    static GLenum format(int channels) {
+        return channels == 1 ? GL_RED : channels == 2 ? GL_RG : channels == 3 ? GL_RGB : GL_RGBA;
+    }
+
+    unsigned int request(GLenum target, const std::vector<std::string>& paths, const StreamedTextureSettings& settings) {
+        Image* image = new Image();
+        image->target = target;
+        image->settings = settings;
+        image->paths = paths;
+        glGenTextures(1, &image->texture);
+        GLState::Get().BindTexture(0, target, image->texture);
+        for (size_t face = 0; face < paths.size(); face++)
+            glTexImage2D(faceTarget(*image, face), 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, settings.placeholder);
+        applyParameters(*image, false);
+
+        m_Pending++;
+        unsigned int texture = image->texture;
+        m_InFlight[texture] = image;
+        m_Jobs.Submit([this, image]() {
+            if (!loadCooked(*image))
+                decode(*image);
+            m_Ready.Push(image);
+        }, &m_Decoding);
+        return texture;
+    }
+
+    // every face needs a current cooked file of the same format and size, otherwise none is used
+    bool loadCooked(Image& image) const {
+        RG_PROFILE_FUNCTION();
+        for (const std::string& path : image.paths) {
+            KtxTexture texture;
+            if (!CookedTextureIsCurrent(path) || !ReadKtx(CookedTexturePath(path), texture) || texture.faces != 1 || !supported(texture.internalFormat)
+                || (!image.cooked.empty() && (texture.internalFormat != image.cooked[0].internalFormat
+                                              || texture.width != image.cooked[0].width || texture.height != image.cooked[0].height
+                                              || texture.levels != image.cooked[0].levels))) {
+                image.cooked.clear();
+                return false;
+            }
+            image.cooked.push_back(std::move(texture));
+        }
+        image.width = (int) image.cooked[0].width;
+        image.height = (int) image.cooked[0].height;
+        image.channels = (int) image.cooked[0].sourceChannels;
+        return true;
+    }
+
+    bool supported(GLenum internalFormat) const {
+        return internalFormat == GL_COMPRESSED_RED_RGTC1
+               || (m_S3tcSupported && (internalFormat == GL_COMPRESSED_RGB_S3TC_DXT1_EXT || internalFormat == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT));
+    }
+
+    static void decode(Image& image) {
+        RG_PROFILE_FUNCTION();
+        for (const std::string& path : image.paths) {
+            int width, height, channels;
+            unsigned char* pixels = stbi_load(path.c_str(), &width, &height, &channels, 0);
+            if (pixels == nullptr || (!image.pixels.empty() && (width != image.width || height != image.height || channels != image.channels))) {
+                stbi_image_free(pixels);
+                image.failed = true;
+                return;
+            }
+            image.width = width;
+            image.height = height;
+            image.channels = channels;
+            image.pixels.push_back(pixels);
+        }
+    }
+
+    void upload(Image& image) {
+        RG_PROFILE_FUNCTION();
+        if (image.failed) {
+            std::cout << "Texture failed to load at path: " << image.paths[image.pixels.size()] << std::endl;
+            return;
+        }
+        std::vector<Surface> surfaces = collectSurfaces(image);
+        size_t bytes = 0;
+        for (const Surface& surface : surfaces)
+            bytes += surface.size;
+
+        // orphaning the buffer lets the driver hand out fresh storage while earlier uploads are in flight
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_Pbo);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, bytes, nullptr, GL_STREAM_DRAW);
+        unsigned char* mapped = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+        if (mapped != nullptr) {
+            size_t offset = 0;
+            for (const Surface& surface : surfaces) {
+                std::memcpy(mapped + offset, surface.source, surface.size);
+                offset += surface.size;
+            }
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        } else {
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        }
+
+        GLState::Get().BindTexture(0, image.target, image.texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        TextureMemoryRecord record = {image.paths[0], !image.cooked.empty(), 0, 0, 0};
+        if (image.cooked.empty()) {
+            GLenum pixelFormat = format(image.channels);
+            size_t offset = 0;
+            for (const Surface& surface : surfaces) {
+                // with the buffer bound the pointer is an offset into it
+                const void* source = mapped != nullptr ? (const void*) offset : surface.source;
+                glTexImage2D(surface.target, 0, pixelFormat, surface.width, surface.height, 0, pixelFormat, GL_UNSIGNED_BYTE, source);
+                offset += surface.size;
+            }
+            if (image.settings.mipmaps)
+                glGenerateMipmap(image.target);
+            record.internalFormat = pixelFormat;
+            record.gpuBytes = MipChainBytes(image.width, image.height, image.channels, image.settings.mipmaps) * image.pixels.size();
+        } else {
+            GLenum internalFormat = image.cooked[0].internalFormat;
+            int levels = image.settings.mipmaps ? (int) image.cooked[0].levels : 1;
+            // immutable storage replaces the placeholder and fixes the mip chain in one call
+            if (m_TexStorage2D != nullptr)
+                m_TexStorage2D(image.target, levels, internalFormat, image.width, image.height);
+            size_t offset = 0;
+            for (const Surface& surface : surfaces) {
+                const void* source = mapped != nullptr ? (const void*) offset : surface.source;
+                if (m_TexStorage2D != nullptr)
+                    glCompressedTexSubImage2D(surface.target, surface.level, 0, 0, surface.width, surface.height, internalFormat, (GLsizei) surface.size, source);
+                else
+                    glCompressedTexImage2D(surface.target, surface.level, internalFormat, surface.width, surface.height, 0, (GLsizei) surface.size, source);
+                offset += surface.size;
+            }
+            glTexParameteri(image.target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+            // grey images are cooked to one channel, sample them as grey again
+            if (internalFormat == GL_COMPRESSED_RED_RGTC1) {
+                glTexParameteri(image.target, GL_TEXTURE_SWIZZLE_G, GL_RED);
+                glTexParameteri(image.target, GL_TEXTURE_SWIZZLE_B, GL_RED);
+            }
+            record.internalFormat = internalFormat;
+            record.gpuBytes = bytes;
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        applyParameters(image, image.channels == 4 && image.settings.clampTransparent);
+
+        record.uncompressedBytes = MipChainBytes(image.width, image.height, image.channels, image.settings.mipmaps) * image.paths.size();
+        m_Memory.push_back(record);
+        m_Stats.uploads++;
+        m_Stats.bytes += bytes;
+    }
+
+    std::vector<Surface> collectSurfaces(const Image& image) const {
+        std::vector<Surface> surfaces;
+        if (image.cooked.empty()) {
+            size_t faceBytes = (size_t) image.width * image.height * image.channels;
+            for (size_t face = 0; face < image.pixels.size(); face++)
+                surfaces.push_back({faceTarget(image, face), 0, image.width, image.height, image.pixels[face], faceBytes});
+            return surfaces;
+        }
+        uint32_t levels = image.settings.mipmaps ? image.cooked[0].levels : 1;
+        for (uint32_t level = 0; level < levels; level++) {
+            for (size_t face = 0; face < image.cooked.size(); face++) {
+                const KtxTexture& texture = image.cooked[face];
+                const KtxImage& levelImage = texture.Image(level);
+                surfaces.push_back({faceTarget(image, face), (int) level, (int) levelImage.width, (int) levelImage.height,
+                                    texture.data.data() + levelImage.offset, levelImage.size});
+            }
+        }
+        return surfaces;
+    }
+
+    static void applyParameters(const Image& image, bool clamp) {
+        glTexParameteri(image.target, GL_TEXTURE_WRAP_S, clamp ? GL_CLAMP_TO_EDGE : image.settings.wrapS);
+        glTexParameteri(image.target, GL_TEXTURE_WRAP_T, clamp ? GL_CLAMP_TO_EDGE : image.settings.wrapT);
+        if (image.target == GL_TEXTURE_CUBE_MAP)
+            glTexParameteri(image.target, GL_TEXTURE_WRAP_R, clamp ? GL_CLAMP_TO_EDGE : image.settings.wrapT);
+        glTexParameteri(image.target, GL_TEXTURE_MIN_FILTER, image.settings.mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+        glTexParameteri(image.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    static void release(Image* image) {
+        for (unsigned char* pixels : image->pixels)
+            stbi_image_free(pixels);
+        delete image;
+    }
+};
+
+#endif //PROJECT_BASE_TEXTURESTREAMER_H
@@ -0,0 +1,83 @@
+#ifndef PROJECT_BASE_UNIFORMBUFFER_H
+#define PROJECT_BASE_UNIFORMBUFFER_H
+
+#include <glad/glad.h>
+#include <cstring>
+
+// binding points shared by every program that declares the matching std140 block
+enum UniformBlockBinding {
+    CAMERA_BLOCK_BINDING = 0,
+    LIGHTS_BLOCK_BINDING = 1
+};
+
+// A uniform buffer holding one T, where T mirrors a std140 block byte for byte (explicit
+// padding included). A copy of what was last uploaded is kept, and Update only sends the
+// 16 byte slots that differ from it, merged into contiguous ranges.
+template<typename T>
+class UniformBuffer {
+public:
+    static const size_t Slot = 16;
+
+    explicit UniformBuffer(unsigned int binding)
+            : m_Binding(binding) {
+        glGenBuffers(1, &m_Id);
+        glBindBuffer(GL_UNIFORM_BUFFER, m_Id);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(T), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        glBindBufferBase(GL_UNIFORM_BUFFER, m_Binding, m_Id);
+    }
+
+    ~UniformBuffer() {
+        glDeleteBuffers(1, &m_Id);
+    }
+
+    UniformBuffer(const UniformBuffer&) = delete;
+    UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+    void Update(const T& value) {
+        const unsigned char* next = reinterpret_cast<const unsigned char*>(&value);
+        unsigned char* last = reinterpret_cast<unsigned char*>(&m_Uploaded);
+        m_LastUploadBytes = 0;
+        bool bound = false;
+
+        size_t offset = 0;
+        while (offset < sizeof(T)) {
+            if (m_Valid && std::memcmp(next + offset, last + offset, slotSize(offset)) == 0) {
+                offset += Slot;
+                continue;
+            }
+            size_t end = offset + slotSize(offset);
+            while (end < sizeof(T) && (!m_Valid || std::memcmp(next + end, last + end, slotSize(end)) != 0))
+                end += slotSize(end);
+
+            if (!bound) {
+                glBindBuffer(GL_UNIFORM_BUFFER, m_Id);
+                bound = true;
+            }
+            glBufferSubData(GL_UNIFORM_BUFFER, offset, end - offset, next + offset);
+            std::memcpy(last + offset, next + offset, end - offset);
+            m_LastUploadBytes += end - offset;
+            offset = end;
+        }
+        if (bound)
+            glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        m_Valid = true;
+    }
+
+    unsigned int Binding() const { return m_Binding; }
+    // bytes sent by the last Update, 0 when nothing changed
+    size_t LastUploadBytes() const { return m_LastUploadBytes; }
+
+private:
+    unsigned int m_Id = 0;
+    unsigned int m_Binding;
+    T m_Uploaded;
+    bool m_Valid = false;
+    size_t m_LastUploadBytes = 0;
+
+    static size_t slotSize(size_t offset) {
+        return offset + Slot <= sizeof(T) ? Slot : sizeof(T) - offset;
+    }
+};
+
+#endif //PROJECT_BASE_UNIFORMBUFFER_H
@@ -0,0 +1,251 @@
+#ifndef PROJECT_BASE_VERTEXPACKING_H
+#define PROJECT_BASE_VERTEXPACKING_H
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// How Mesh::setupMesh lays out the vertices of one mesh. The unpacked layout is Vertex as is.
+// The packed one interleaves, in this order:
+//   position   3 x int16 + padding, or 3 x float when quantizing would exceed the tolerance
+//   normal     2 x int16, octahedral
+//   texCoords  2 x half, or 2 x float when half precision would exceed the tolerance
+//   tangent    4 x int16: octahedral tangent, bitangent sign, padding (only when requested)
+// The integers are passed unnormalized. Quantized positions are scaled back by
+// Mesh::PositionTransform, and the shader divides the octahedral vectors by 32767. This avoids the
+// snorm conversion rule that changed between GL 3.3 and 4.2.
+struct VertexLayout {
+    bool packed = false;
+    bool quantizedPositions = false;
+    bool halfTexCoords = false;
+    bool tangents = true;
+    unsigned int stride = 0;
+    unsigned int normalOffset = 0;
+    unsigned int texCoordOffset = 0;
+    unsigned int tangentOffset = 0;
+
+    // meshes with equal layouts can share one VAO
+    bool operator==(const VertexLayout& other) const {
+        return packed == other.packed && quantizedPositions == other.quantizedPositions && halfTexCoords == other.halfTexCoords
+               && tangents == other.tangents && stride == other.stride && normalOffset == other.normalOffset
+               && texCoordOffset == other.texCoordOffset && tangentOffset == other.tangentOffset;
+    }
+    bool operator!=(const VertexLayout& other) const { return !(*this == other); }
+};
+
+struct VertexPackingOptions {
+    bool enabled = false;
+    bool tangents = false;                      // no shipped shader reads tangents or bitangents
+    float positionTolerance = 1e-4f;            // relative to the largest distance from the bounds center along an axis
+    float normalTolerance = 1e-3f;              // distance between the unit vectors
+    float texCoordTolerance = 1.0f / 2048.0f;   // half a texel of a 1024 texture
+};
+
+// largest error of any decoded vertex against the source, and the size of the vertex data
+struct VertexPackingReport {
+    float positionError = 0.0f;
+    float normalError = 0.0f;
+    float texCoordError = 0.0f;
+    float tangentError = 0.0f;
+    size_t bytes = 0;
+    size_t unpackedBytes = 0;
+
+    void Merge(const VertexPackingReport& other) {
+        positionError = std::max(positionError, other.positionError);
+        normalError = std::max(normalError, other.normalError);
+        texCoordError = std::max(texCoordError, other.texCoordError);
+        tangentError = std::max(tangentError, other.tangentError);
+        bytes += other.bytes;
+        unpackedBytes += other.unpackedBytes;
+    }
+};
+
+struct PackedVertices {
+    VertexLayout layout;
+    std::vector<unsigned char> data;
+    // decoded position = positionOffset + positionScale * stored integers
+    glm::vec3 positionOffset = glm::vec3(0.0f);
+    float positionScale = 1.0f;
+    VertexPackingReport report;
+};
+
+namespace vertexpacking {
+
+inline uint16_t floatToHalf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+    uint32_t sign = (bits >> 16) & 0x8000u;
+    int exponent = (int) ((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffffu;
+    if (exponent >= 31)
+        return (uint16_t) (sign | 0x7c00u | (((bits >> 23) & 0xff) == 0xff && mantissa != 0 ? 0x200u : 0u));
+    if (exponent <= 0) {
+        if (exponent < -10)
+            return (uint16_t) sign;
+        // subnormal, round to nearest even
+        mantissa |= 0x800000u;
+        int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t midpoint = 1u << (shift - 1);
+        if (rest > midpoint || (rest == midpoint && (half & 1u)))
+            half++;
+        return (uint16_t) (sign | half);
+    }
+    uint32_t half = sign | ((uint32_t) exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fffu;
+    // a carry out of the mantissa correctly bumps the exponent
+    if (rest > 0x1000u || (rest == 0x1000u && (half & 1u)))
+        half++;
+    return (uint16_t) half;
+}
+
+inline float halfToFloat(uint16_t half) {
+    uint32_t sign = (uint32_t) (half & 0x8000u) << 16;
+    uint32_t exponent = (half >> 10) & 0x1fu;
+    uint32_t mantissa = half & 0x3ffu;
+    uint32_t bits;
+    if (exponent == 0) {
+        float value = std::ldexp((float) mantissa, -24);
+        return sign ? -value : value;
+    }
+    if (exponent == 31)
+        bits = sign | 0x7f800000u | (mantissa << 13);
+    else
+        bits = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    float value;
+    std::memcpy(&value, &bits, 4);
+    return value;
+}
+
+inline int16_t toSnorm16(float value) {
+    return (int16_t) std::lround(std::min(std::max(value, -1.0f), 1.0f) * 32767.0f);
+}
+
+inline float signNotZero(float value) { return value >= 0.0f ? 1.0f : -1.0f; }
+
+inline glm::vec3 octDecode(int16_t x, int16_t y) {
+    glm::vec2 e(x / 32767.0f, y / 32767.0f);
+    glm::vec3 n(e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y));
+    if (n.z < 0.0f) {
+        float nx = (1.0f - std::abs(n.y)) * signNotZero(n.x);
+        float ny = (1.0f - std::abs(n.x)) * signNotZero(n.y);
+        n.x = nx;
+        n.y = ny;
+    }
+    return glm::normalize(n);
+}
+
+// Projects the unit vector onto the octahedron and unfolds the lower half. Of the four roundings
+// around the projection the one decoding closest to the vector is kept.
+inline void octEncode(const glm::vec3& vector, int16_t out[2]) {
+    glm::vec3 n = vector / (std::abs(vector.x) + std::abs(vector.y) + std::abs(vector.z));
+    glm::vec2 e(n.x, n.y);
+    if (n.z < 0.0f)
+        e = glm::vec2((1.0f - std::abs(n.y)) * signNotZero(n.x), (1.0f - std::abs(n.x)) * signNotZero(n.y));
+    float bestError = 1e30f;
+    for (int i = 0; i < 4; i++) {
+        int16_t x = (int16_t) std::min(32767.0f, std::max(-32767.0f, (i & 1 ? std::ceil(e.x * 32767.0f) : std::floor(e.x * 32767.0f))));
+        int16_t y = (int16_t) std::min(32767.0f, std::max(-32767.0f, (i & 2 ? std::ceil(e.y * 32767.0f) : std::floor(e.y * 32767.0f))));
+        float error = glm::length(octDecode(x, y) - vector);
+        if (error < bestError) {
+            bestError = error;
+            out[0] = x;
+            out[1] = y;
+        }
+    }
+}
+
+inline unsigned int align4(unsigned int offset) { return (offset + 3u) & ~3u; }
+
+} // namespace vertexpacking
+
+// Encodes the vertices of one mesh in the packed layout and measures what decoding loses.
+// Positions and texture coordinates go back to floats for this mesh when their error exceeds the
+// tolerance. Zero normals have no direction to keep and are stored as +Z. V needs Position,
+// Normal, TexCoords, Tangent and Bitangent like Vertex.
+template<typename V>
+PackedVertices PackVertices(const V* vertices, size_t count, const glm::vec3& boundsCenter, const VertexPackingOptions& options) {
+    using namespace vertexpacking;
+    PackedVertices packed;
+    VertexLayout& layout = packed.layout;
+    VertexPackingReport& report = packed.report;
+    layout.packed = true;
+    layout.tangents = options.tangents;
+
+    float extent = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 d = glm::abs(vertices[i].Position - boundsCenter);
+        extent = std::max(extent, std::max(d.x, std::max(d.y, d.z)));
+    }
+    packed.positionOffset = boundsCenter;
+    packed.positionScale = extent > 0.0f ? extent / 32767.0f : 1.0f;
+    float positionError = 0.0f, texCoordError = 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 q = glm::round((vertices[i].Position - boundsCenter) / packed.positionScale);
+        positionError = std::max(positionError, glm::length(boundsCenter + q * packed.positionScale - vertices[i].Position));
+        for (int c = 0; c < 2; c++)
+            texCoordError = std::max(texCoordError, std::abs(halfToFloat(floatToHalf(vertices[i].TexCoords[c])) - vertices[i].TexCoords[c]));
+    }
+    layout.quantizedPositions = positionError <= options.positionTolerance * std::max(extent, 1e-20f);
+    layout.halfTexCoords = texCoordError <= options.texCoordTolerance;
+    report.positionError = layout.quantizedPositions ? positionError : 0.0f;
+    report.texCoordError = layout.halfTexCoords ? texCoordError : 0.0f;
+    if (!layout.quantizedPositions) {
+        packed.positionOffset = glm::vec3(0.0f);
+        packed.positionScale = 1.0f;
+    }
+
+    layout.normalOffset = layout.quantizedPositions ? 8 : 12;
+    layout.texCoordOffset = layout.normalOffset + 4;
+    layout.tangentOffset = layout.texCoordOffset + (layout.halfTexCoords ? 4 : 8);
+    layout.stride = align4(layout.tangentOffset + (layout.tangents ? 8 : 0));
+
+    packed.data.assign(count * layout.stride, 0);
+    for (size_t i = 0; i < count; i++) {
+        const V& vertex = vertices[i];
+        unsigned char* out = packed.data.data() + i * layout.stride;
+        if (layout.quantizedPositions) {
+            glm::vec3 q = glm::round((vertex.Position - boundsCenter) / packed.positionScale);
+            int16_t position[4] = {(int16_t) q.x, (int16_t) q.y, (int16_t) q.z, 0};
+            std::memcpy(out, position, 8);
+        } else {
+            std::memcpy(out, &vertex.Position[0], 12);
+        }
+
+        float normalLength = glm::length(vertex.Normal);
+        glm::vec3 normal = normalLength > 0.0f ? vertex.Normal / normalLength : glm::vec3(0.0f, 0.0f, 1.0f);
+        int16_t octNormal[2];
+        octEncode(normal, octNormal);
+        std::memcpy(out + layout.normalOffset, octNormal, 4);
+        if (normalLength > 0.0f)
+            report.normalError = std::max(report.normalError, glm::length(octDecode(octNormal[0], octNormal[1]) - normal));
+
+        if (layout.halfTexCoords) {
+            uint16_t texCoords[2] = {floatToHalf(vertex.TexCoords.x), floatToHalf(vertex.TexCoords.y)};
+            std::memcpy(out + layout.texCoordOffset, texCoords, 4);
+        } else {
+            std::memcpy(out + layout.texCoordOffset, &vertex.TexCoords[0], 8);
+        }
+
+        if (layout.tangents) {
+            float tangentLength = glm::length(vertex.Tangent);
+            glm::vec3 tangent = tangentLength > 0.0f ? vertex.Tangent / tangentLength : glm::vec3(1.0f, 0.0f, 0.0f);
+            // the bitangent is rebuilt as sign * cross(normal, tangent)
+            float sign = glm::dot(glm::cross(normal, tangent), vertex.Bitangent) < 0.0f ? -1.0f : 1.0f;
+            int16_t octTangent[4] = {0, 0, toSnorm16(sign), 0};
+            octEncode(tangent, octTangent);
+            std::memcpy(out + layout.tangentOffset, octTangent, 8);
+            if (tangentLength > 0.0f)
+                report.tangentError = std::max(report.tangentError, glm::length(octDecode(octTangent[0], octTangent[1]) - tangent));
+        }
+    }
+    report.bytes = packed.data.size();
+    report.unpackedBytes = count * sizeof(V);
+    return packed;
+}
+
+#endif //PROJECT_BASE_VERTEXPACKING_H
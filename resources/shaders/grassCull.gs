@@ -0,0 +1,18 @@
+#version 330 core
+layout (points) in;
+layout (points, max_vertices = 1) out;
+
+in vec3 vOffset[];
+flat in int vVisible[];
+
+// captured by transform feedback, only the surviving instances are written
+out vec3 outOffset;
+
+void main()
+{
+    if (vVisible[0] == 1) {
+        outOffset = vOffset[0];
+        EmitVertex();
+        EndPrimitive();
+    }
+}
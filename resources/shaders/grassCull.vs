@@ -0,0 +1,36 @@
+#version 330 core
+layout (location = 3) in vec3 aOffset;
+
+out vec3 vOffset;
+flat out int vVisible;
+
+// inward facing frustum planes, xyz = normal, w = distance
+uniform vec4 frustumPlanes[6];
+uniform vec3 cameraPosition;
+// bounds of a single tuft relative to its position
+uniform vec3 tuftMin;
+uniform vec3 tuftMax;
+// instances closer than distanceRange.x or not closer than distanceRange.y are dropped
+uniform vec2 distanceRange;
+// false skips the frustum test, only the distance range applies
+uniform bool frustumCulling;
+
+void main()
+{
+    vec3 boxMin = aOffset + tuftMin;
+    vec3 boxMax = aOffset + tuftMax;
+
+    bool visible = true;
+    for (int i = 0; i < 6 && frustumCulling; i++) {
+        vec3 positive = mix(boxMin, boxMax, step(vec3(0.0), frustumPlanes[i].xyz));
+        if (dot(frustumPlanes[i].xyz, positive) + frustumPlanes[i].w < 0.0)
+            visible = false;
+    }
+
+    float distance = length(cameraPosition - clamp(cameraPosition, boxMin, boxMax));
+    if (distance < distanceRange.x || distance >= distanceRange.y)
+        visible = false;
+
+    vOffset = aOffset;
+    vVisible = visible ? 1 : 0;
+}
@@ -7,6 +7,8 @@ struct Material {
     float shininess;
 };
 
+// floats are packed behind vec3s to fill their 16 byte std140 slots, the C++ structs in
+// main.cpp mirror this layout
 struct DirLight {
     vec3 direction;
 
@@ -17,28 +19,26 @@ struct DirLight {
 
 struct PointLight {
     vec3 position;
+    float constant;
 
     vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-
-    float constant;
     float linear;
+    vec3 diffuse;
     float quadratic;
+    vec3 specular;
 };
 
 struct SpotLight {
     vec3 position;
-    vec3 direction;
     float cutOff;
+    vec3 direction;
     float outerCutOff;
 
     vec3 ambient;
-    vec3 diffuse;
-    vec3 specular;
-
     float constant;
+    vec3 diffuse;
     float linear;
+    vec3 specular;
     float quadratic;
 };
 
@@ -46,11 +46,19 @@ in vec3 FragPos;
 in vec3 Normal;
 in vec2 TexCoords;
 
-uniform vec3 viewPosition;
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
+
+layout (std140) uniform Lights {
+    DirLight dirLight;
+    PointLight pointLight;
+    SpotLight spotLight;
+};
+
 uniform Material material;
-uniform DirLight dirLight;
-uniform PointLight pointLight;
-uniform SpotLight spotLight;
 
 vec3 CalcDirLight(DirLight light, vec3 normal, vec3 viewDir);
 vec3 CalcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir);
@@ -0,0 +1,25 @@
+#version 330 core
+layout (location = 0) in vec3 aPos;
+layout (location = 1) in vec3 aNormal;
+layout (location = 2) in vec2 aTexCoords;
+layout (location = 3) in vec3 aOffset;
+
+out vec3 FragPos;
+out vec3 Normal;
+out vec2 TexCoords;
+
+layout (std140) uniform Camera {
+    mat4 projection;
+    mat4 view;
+    vec3 viewPosition;
+};
+
+void main()
+{
+    // blade rotation/scale is baked into the tuft mesh, the instance only carries its position
+    FragPos = aPos + aOffset;
+    Normal = aNormal;
+    TexCoords = aTexCoords;
+
+    gl_Position = projection * view * vec4(FragPos, 1.0);
+}
@@ -14,7 +14,34 @@
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
 
+#include <rg/Frustum.h>
+#include <rg/GrassField.h>
+#include <rg/GrassGpuCuller.h>
+#include <rg/GrassBenchmark.h>
+#include <rg/UniformBuffer.h>
+#include <rg/GLState.h>
+#include <rg/RenderQueue.h>
+#include <rg/CullingBenchmark.h>
+#include <rg/JobSystem.h>
+#include <rg/Framebuffer.h>
+#include <rg/FrameBenchmark.h>
+#include <rg/CameraTrack.h>
+#include <rg/GpuProfiler.h>
+#include <rg/CpuProfiler.h>
+#include <rg/ObjBenchmark.h>
+#include <rg/TextureStreamer.h>
+#include <rg/TextureCooker.h>
+#include <rg/FrameArena.h>
+#include <rg/ResourceManager.h>
+// the replacement operator new counting every heap allocation lives in this translation unit
+#define RG_ALLOCATION_COUNTER_IMPLEMENTATION
+#include <rg/AllocationCounter.h>
+
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
+#include <cfloat>
+#include <memory>
 
 void framebuffer_size_callback(GLFWwindow *window, int width, int height);
 
@@ -40,38 +67,74 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
+// The light structs mirror the std140 layout of the Lights uniform block in mainShader.fs and
+// grassShader.fs: every vec3 takes a 16 byte slot, shared with the float after it or padded.
 struct PointLight {
     glm::vec3 position;
-    glm::vec3 ambient;
-    glm::vec3 diffuse;
-    glm::vec3 specular;
-
     float constant;
+
+    glm::vec3 ambient;
     float linear;
+    glm::vec3 diffuse;
     float quadratic;
+    glm::vec3 specular;
+    float padding = 0.0f;
 };
 
 struct SpotLight{
     glm::vec3 position;
-    glm::vec3 direction;
     float cutOff;
+    glm::vec3 direction;
     float outerCutOff;
 
-    float constant;
-    float linear;
-    float quadratic;
-
     glm::vec3 ambient;
+    float constant;
     glm::vec3 diffuse;
+    float linear;
     glm::vec3 specular;
+    float quadratic;
 };
 
 struct DirLight{
     glm::vec3 direction;
+    float padding0 = 0.0f;
 
     glm::vec3 ambient;
+    float padding1 = 0.0f;
     glm::vec3 diffuse;
+    float padding2 = 0.0f;
     glm::vec3 specular;
+    float padding3 = 0.0f;
+};
+
+// contents of the Lights block
+struct LightUniforms {
+    DirLight dirLight;
+    PointLight pointLight;
+    SpotLight spotLight;
+};
+
+// contents of the Camera block
+struct CameraUniforms {
+    glm::mat4 projection;
+    glm::mat4 view;
+    glm::vec3 viewPosition;
+    float padding = 0.0f;
+};
+
+static_assert(sizeof(DirLight) == 64 && sizeof(PointLight) == 64 && sizeof(SpotLight) == 80, "light structs must match std140");
+static_assert(sizeof(LightUniforms) == 208 && sizeof(CameraUniforms) == 144, "uniform blocks must match std140");
+
+// uniform locations the render loop sets every frame, resolved once per shader
+struct ShaderLocations {
+    int model, view, projection, shininess;
+
+    explicit ShaderLocations(const Shader& shader) {
+        model = shader.getUniformLocation("model");
+        view = shader.getUniformLocation("view");
+        projection = shader.getUniformLocation("projection");
+        shininess = shader.getUniformLocation("material.shininess");
+    }
 };
 
 struct ProgramState {
@@ -84,6 +147,26 @@ struct ProgramState {
     PointLight pointLight;
     DirLight dirLight;
     SpotLight spotLight;
+    int GrassMode = GRASS_MODE_CPU_CULLED;
+    bool GrassCulling = true;
+    bool GrassLod = true;
+    int GrassFieldSize = 100;
+    float GrassCpuTime = 0.0f;
+    GrassBenchmark grassBenchmark;
+    size_t UniformUploadBytes = 0;
+    bool MeshCulling = true;
+    std::vector<CullingBenchmarkResult> CullingBenchmarkResults;
+    CameraTrack cameraTrack;
+    bool RecordingCamera = false;
+    CameraPlayer cameraPlayer;
+    std::string CameraTrackPath = "resources/camera_track.bin";
+    std::string TracePath = "cpu_trace.json";
+    // GL thread time per frame spent uploading streamed textures
+    float TextureUploadBudgetMs = 2.0f;
+    // operator new calls of the last whole frame, 0 once the frame has reached its steady state
+    unsigned long long FrameHeapAllocations = 0;
+    size_t FrameArenaBytes = 0;
+    size_t FrameArenaCapacity = 0;
     ProgramState()
             : camera(glm::vec3(0.0f, 0.0f, 3.0f)) {}
 
@@ -124,33 +207,81 @@ void ProgramState::LoadFromFile(std::string filename) {
 
 ProgramState *programState;
 
-void DrawImGui(ProgramState *programState);
-
-unsigned int loadTexture(char const * path);
-
-void bindPointLight(Shader &shader, PointLight pointLight);
+// Shuts ImGui and GLFW down when main returns. Declared before every local that owns GL objects,
+// so their destructors run first, while the context is still current.
+struct ContextTeardown {
+    ~ContextTeardown() {
+        if (ImGui::GetCurrentContext() != nullptr) {
+            ImGui_ImplOpenGL3_Shutdown();
+            ImGui_ImplGlfw_Shutdown();
+            ImGui::DestroyContext();
+        }
+        glfwTerminate();
+    }
+};
 
-void bindCameraPosition(Shader &shader, glm::vec3 position);
+void DrawImGui(ProgramState *programState, const GrassField& grassField, const GrassGpuCuller& grassCuller, const RenderQueue& renderQueue, const JobSystem& jobs, GpuProfiler& profiler, const TextureStreamer& textureStreamer);
 
-void bindShininess(Shader &shader, float value);
+ResourceHandle<TextureResource> loadTexture(TextureStreamer &streamer, char const * path);
 
-void setShaderViewMatrix(Shader &shader, glm::mat4 view);
+void bindShininess(Shader &shader, const ShaderLocations &locations, float value);
 
-void setShaderProjectionMatrix(Shader &shader, glm::mat4 projection);
+void bindUniformBlocks(Shader &shader);
 
-void setShaderModelMatrix(Shader &shader, glm::mat4 model);
+void setShaderModelMatrix(Shader &shader, const ShaderLocations &locations, const glm::mat4 &model);
 
 void enableShaderDiffuseComponent(Shader &shader);
 
 void enableShaderSpecularComponent(Shader &shader);
 
-void bindSpotLight(Shader &shader, SpotLight spotLight);
-
-void bindDirLight(Shader &shader, DirLight dirLight);
+ResourceHandle<TextureResource> loadCubemap(TextureStreamer &streamer, vector<std::string> faces);
+
+// --benchmark [frames] renders that many frames offscreen and prints their timings as JSON, alone
+// on stdout or into the file given with --benchmark-out path,
+// --egl creates the context through EGL instead of GLX,
+// --record path records the camera until exit, --play path flies along a recorded track
+// (--playback frames|fixed|realtime, --step seconds for the fixed mode)
+struct CommandLine {
+    bool benchmark = false;
+    int benchmarkFrames = 600;
+    int warmupFrames = 60;
+    std::string benchmarkOutPath;
+    bool egl = false;
+    std::string recordPath;
+    std::string playPath;
+    PlaybackMode playbackMode = PLAYBACK_RECORDED_FRAMES;
+    float playbackStep = 1.0f / 60.0f;
+    std::string tracePath;
+    int objBenchmarkIterations = 0;
+    bool cookTextures = false;
+    bool packVertices = true;
+    bool keepGeometry = false;
+    bool mergeMeshes = false;
+};
 
-unsigned int loadCubemap(vector<std::string> faces);
+CommandLine parseCommandLine(int argc, char** argv);
+
+int main(int argc, char** argv) {
+    CommandLine commandLine = parseCommandLine(argc, argv);
+    // a benchmark printing its JSON keeps stdout for it, everything logged through std::cout goes to stderr
+    std::streambuf* benchmarkOut = std::cout.rdbuf();
+    if (commandLine.benchmark && commandLine.benchmarkOutPath.empty())
+        std::cout.rdbuf(std::cerr.rdbuf());
+    RG_PROFILE_THREAD("main");
+    JobSystem jobs;
+
+    // importer comparison, needs no window
+    if (commandLine.objBenchmarkIterations > 0) {
+        RunObjBenchmark({"resources/objects/goalpost/10502_Football_Goalpost_v1_L3.obj",
+                         "resources/objects/projector/projector_mast.obj"}, jobs, commandLine.objBenchmarkIterations);
+        return 0;
+    }
+    // offline texture compression, the streamer picks the cooked files up on the next start
+    if (commandLine.cookTextures) {
+        CookTextures("resources", jobs);
+        return 0;
+    }
 
-int main() {
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -163,6 +294,15 @@ int main() {
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
+    if (commandLine.benchmark) {
+        // the window only provides the context, frames go to an offscreen framebuffer
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#if defined(__linux__) && defined(GLFW_EGL_CONTEXT_API)
+        // EGL works with Mesa's llvmpipe on machines without a GPU
+        if (commandLine.egl)
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_EGL_CONTEXT_API);
+#endif
+    }
 
     // glfw window creation
     // --------------------
@@ -178,21 +318,42 @@ int main() {
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetKeyCallback(window, key_callback);
     // tell GLFW to capture our mouse
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (!commandLine.benchmark)
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
     // glad: load all OpenGL function pointers
     // ---------------------------------------
     if (!gladLoadGLLoader((GLADloadproc) glfwGetProcAddress)) {
         std::cout << "Failed to initialize GLAD" << std::endl;
+        glfwTerminate();
         return -1;
     }
+    // the streamer, grass field, culler, uniform buffers, profiler and programs below are
+    // destroyed before this
+    ContextTeardown contextTeardown;
 
     // tell stb_image.h to flip loaded texture's on the y-axis (before loading model).
     stbi_set_flip_vertically_on_load(false);
+    // textures are decoded on the job system and uploaded a few per frame
+    TextureStreamer textureStreamer(jobs, (GLADloadproc) glfwGetProcAddress);
 
 
     programState = new ProgramState;
     programState->LoadFromFile("resources/program_state.txt");
+    if (!commandLine.tracePath.empty())
+        programState->TracePath = commandLine.tracePath;
+    if (commandLine.benchmark)
+        programState->ImGuiEnabled = false;
+    if (!commandLine.recordPath.empty()) {
+        programState->CameraTrackPath = commandLine.recordPath;
+        programState->RecordingCamera = true;
+    }
+    if (!commandLine.playPath.empty()) {
+        if (programState->cameraTrack.Load(commandLine.playPath))
+            programState->cameraPlayer.Start(&programState->cameraTrack, commandLine.playbackMode, commandLine.playbackStep);
+        else
+            std::cerr << "Failed to load camera track " << commandLine.playPath << std::endl;
+    }
     if (programState->ImGuiEnabled) {
         glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
     }
@@ -210,26 +371,87 @@ int main() {
 
 
 
-    glEnable(GL_DEPTH_TEST);
-    glEnable(GL_CULL_FACE);
-    glEnable(GL_MULTISAMPLE);
+    GLState& glState = GLState::Get();
+    glState.Enable(GL_DEPTH_TEST);
+    glState.Enable(GL_CULL_FACE);
+    glState.Enable(GL_MULTISAMPLE);
 
     // build and compile shaders
     // -------------------------
-    Shader mainShader("resources/shaders/mainShader.vs", "resources/shaders/mainShader.fs");
-    Shader grassShader("resources/shaders/grassShader.vs", "resources/shaders/grassShader.fs");
-    Shader planeShader("resources/shaders/planeShader.vs", "resources/shaders/planeShader.fs");
-    Shader skyboxShader("resources/shaders/skyboxShader.vs", "resources/shaders/skyboxShader.fs");
+    // the models are drawn from packed vertices unless --full-vertices asks for the float layout
+    VertexPackingOptions modelPacking;
+    modelPacking.enabled = commandLine.packVertices;
+    // programs, textures and models are shared through the resource manager and released with their last handle
+    ResourceManager& resources = ResourceManager::Get();
+    ResourceHandle<Shader> mainProgram = resources.LoadShader(modelPacking.enabled ? "resources/shaders/mainShaderPacked.vs" : "resources/shaders/mainShader.vs", "resources/shaders/mainShader.fs");
+    ResourceHandle<Shader> grassProgram = resources.LoadShader("resources/shaders/grassShader.vs", "resources/shaders/grassShader.fs");
+    ResourceHandle<Shader> grassInstancedProgram = resources.LoadShader("resources/shaders/grassShaderInstanced.vs", "resources/shaders/grassShader.fs");
+    ResourceHandle<Shader> planeProgram = resources.LoadShader("resources/shaders/planeShader.vs", "resources/shaders/planeShader.fs");
+    ResourceHandle<Shader> skyboxProgram = resources.LoadShader("resources/shaders/skyboxShader.vs", "resources/shaders/skyboxShader.fs");
+    Shader& mainShader = *mainProgram;
+    Shader& grassShader = *grassProgram;
+    Shader& grassInstancedShader = *grassInstancedProgram;
+    Shader& planeShader = *planeProgram;
+    Shader& skyboxShader = *skyboxProgram;
+    // transform feedback programs are not shared
+    Shader grassCullShader("resources/shaders/grassCull.vs", "resources/shaders/grassCull.gs", {"outOffset"});
+
+    ShaderLocations mainLocations(mainShader);
+    ShaderLocations grassLocations(grassShader);
+    ShaderLocations grassInstancedLocations(grassInstancedShader);
+    ShaderLocations planeLocations(planeShader);
+    ShaderLocations skyboxLocations(skyboxShader);
+
+    // camera and lights are shared by every lit program through std140 uniform blocks
+    UniformBuffer<CameraUniforms> cameraBuffer(CAMERA_BLOCK_BINDING);
+    UniformBuffer<LightUniforms> lightBuffer(LIGHTS_BLOCK_BINDING);
+    bindUniformBlocks(mainShader);
+    bindUniformBlocks(grassShader);
+    bindUniformBlocks(grassInstancedShader);
+    bindUniformBlocks(planeShader);
 
 
 
     // load models
     // -----------
-    Model goalModel("resources/objects/goalpost/10502_Football_Goalpost_v1_L3.obj");
-    goalModel.SetShaderTextureNamePrefix("material.");
-
-    Model projectorModel("resources/objects/projector/projector_mast.obj");
-    projectorModel.SetShaderTextureNamePrefix("material.");
+    // the parts of a model are culled on their own unless --merge-meshes joins those sharing a material
+    ResourceHandle<Model> goalModel = Model::Load("resources/objects/goalpost/10502_Football_Goalpost_v1_L3.obj", false, &jobs, &textureStreamer, modelPacking,
+                                                  commandLine.mergeMeshes);
+    goalModel->SetShaderTextureNamePrefix("material.");
+
+    ResourceHandle<Model> projectorModel = Model::Load("resources/objects/projector/projector_mast.obj", false, &jobs, &textureStreamer, modelPacking,
+                                                       commandLine.mergeMeshes);
+    projectorModel->SetShaderTextureNamePrefix("material.");
+
+    // warm starts read the meshes from the caches written next to the models on the first run
+    for (Model* loaded : {goalModel.get(), projectorModel.get()}) {
+        std::cout << loaded->directory << ": " << loaded->LoadMs << " ms"
+                  << (loaded->LoadedFromCache ? " (mesh cache)" : loaded->LoadedNatively ? " (ObjLoader)" : " (Assimp)") << std::endl;
+        const MeshOptimizationReport& optimization = loaded->Optimization;
+        if (optimization.indices > 0)
+            std::cout << "  optimized " << optimization.verticesBefore << " -> " << optimization.verticesAfter << " vertices, ACMR "
+                      << optimization.AcmrBefore() << " -> " << optimization.AcmrAfter() << ", "
+                      << optimization.bytesBefore / 1024 << " KB -> " << optimization.bytesAfter / 1024 << " KB" << std::endl;
+        std::cout << "  " << loaded->ImportedMeshes << " meshes merged by material into " << loaded->meshes.size()
+                  << ", drawn from " << loaded->VertexArrays << " VAO(s) with " << loaded->materials.size() << " material(s)" << std::endl;
+        VertexPackingReport packing = loaded->PackingReport();
+        std::cout << "  vertices " << packing.unpackedBytes / 1024 << " KB -> " << packing.bytes / 1024 << " KB";
+        if (loaded->Packing.enabled)
+            std::cout << ", max error position " << packing.positionError << " normal " << packing.normalError
+                      << " uv " << packing.texCoordError;
+        std::cout << std::endl;
+        // nothing reads the CPU copies after the upload unless --keep-geometry asks for them
+        size_t geometryBytes = loaded->GeometryBytes();
+        if (!commandLine.keepGeometry)
+            loaded->ReleaseGeometry();
+        std::cout << "  resident " << loaded->MemoryBeforeLoad.residentBytes / 1024 << " KB -> "
+                  << loaded->MemoryAfterLoad.residentBytes / 1024 << " KB, peak " << loaded->MemoryAfterLoad.peakResidentBytes / 1024
+                  << " KB, CPU geometry " << geometryBytes / 1024 << " KB" << (commandLine.keepGeometry ? " kept" : " released") << std::endl;
+    }
+    const ResourceCacheStats& modelStats = resources.Models().Stats();
+    const ResourceCacheStats& textureStats = resources.Textures().Stats();
+    std::cout << "Resources: " << modelStats.loads << " model(s) and " << textureStats.loads << " texture(s) loaded, "
+              << modelStats.pathHits + modelStats.contentHits + textureStats.pathHits + textureStats.contentHits << " shared" << std::endl;
 
     PointLight& pointLight = programState->pointLight;
     pointLight.position = glm::vec3(18.0f, 21.5f, 18.0f);
@@ -372,9 +594,13 @@ int main() {
 
     //loading textures
 
-    unsigned int grassTextureDiffuse = loadTexture(FileSystem::getPath("resources/textures/grass_texture.png").c_str()); // Downloaded texture from https://github.com/Vulpinii/grass-tutorial_codebase/blob/master/assets/textures/grass_texture.png
-    unsigned int grassTextureSpecular = loadTexture(FileSystem::getPath("resources/textures/grass_texture_specular.png").c_str());
-    unsigned int planeTexture = loadTexture(FileSystem::getPath("resources/textures/plane_texture.jpg").c_str());
+    // the far grass strips repeat the texture horizontally, and the grass stays invisible until it is uploaded
+    StreamedTextureSettings grassSettings;
+    grassSettings.wrapT = GL_CLAMP_TO_EDGE;
+    std::fill(grassSettings.placeholder, grassSettings.placeholder + 4, 0);
+    ResourceHandle<TextureResource> grassTextureDiffuse = resources.LoadTexture(FileSystem::getPath("resources/textures/grass_texture.png"), textureStreamer, grassSettings); // Downloaded texture from https://github.com/Vulpinii/grass-tutorial_codebase/blob/master/assets/textures/grass_texture.png
+    ResourceHandle<TextureResource> grassTextureSpecular = resources.LoadTexture(FileSystem::getPath("resources/textures/grass_texture_specular.png"), textureStreamer, grassSettings);
+    ResourceHandle<TextureResource> planeTexture = loadTexture(textureStreamer, FileSystem::getPath("resources/textures/plane_texture.jpg").c_str());
 
     vector<std::string> faces
             {
@@ -385,12 +611,16 @@ int main() {
                     FileSystem::getPath("resources/textures/skybox/front.jpg"),
                     FileSystem::getPath("resources/textures/skybox/back.jpg")
             };
-    unsigned int cubemapTexture = loadCubemap(faces);
+    ResourceHandle<TextureResource> cubemapTexture = loadCubemap(textureStreamer, faces);
 
     grassShader.use();
     enableShaderDiffuseComponent(grassShader);
     enableShaderSpecularComponent(grassShader);
 
+    grassInstancedShader.use();
+    enableShaderDiffuseComponent(grassInstancedShader);
+    enableShaderSpecularComponent(grassInstancedShader);
+
     planeShader.use();
     planeShader.setInt("texture1", 0);
 
@@ -399,14 +629,61 @@ int main() {
 
     //calculating grass position
 
-    vector<glm::vec3> grassPosition;
-    for(int i = 0;i < 100;i++)
-        for(int j = 0;j < 100;j++)
-            grassPosition.push_back(glm::vec3(i - 50.0f, 0.3f, j - 50.0f));
+    // worker threads for the frame's CPU work, this thread only issues GL calls
+    GrassField grassField(grassVertices, 6);
+    grassField.Jobs = &jobs;
+    grassField.Build(programState->GrassFieldSize);
+    std::vector<glm::mat4> grassQuadTransforms;
+    GrassGpuCuller grassCuller(grassCullShader);
+
+    GpuProfiler gpuProfiler;
+    const int modelsSection = gpuProfiler.AddSection("Models");
+    const int planeSection = gpuProfiler.AddSection("Plane");
+    const int grassSection = gpuProfiler.AddSection("Grass");
+    const int skyboxSection = gpuProfiler.AddSection("Skybox");
+    const int imguiSection = gpuProfiler.AddSection("ImGui");
+
+    // transient per frame memory, the draw list lives here
+    FrameArena frameArena;
+    RenderQueue renderQueue;
+    renderQueue.Profiler = &gpuProfiler;
+    renderQueue.Arena = &frameArena;
+
+    // loading bound buffers and textures directly, start the render loop from a clean slate
+    glState.Invalidate();
+
+    std::unique_ptr<Framebuffer> offscreen;
+    std::unique_ptr<FrameBenchmark> frameBenchmark;
+    if (commandLine.benchmark) {
+        offscreen.reset(new Framebuffer(SCR_WIDTH, SCR_HEIGHT, programState->AntiAliasing ? 4 : 0));
+        frameBenchmark.reset(new FrameBenchmark(commandLine.benchmarkFrames, commandLine.warmupFrames));
+        glfwSwapInterval(0);
+        // measured frames should not include texture uploads
+        textureStreamer.Finish();
+    }
 
     // render loop
     // -----------
-    while (!glfwWindowShouldClose(window)) {
+    bool playingTrack = programState->cameraPlayer.Playing();
+    unsigned long long frameStartAllocations = AllocationCounter::Allocations();
+    while (!glfwWindowShouldClose(window) && !(frameBenchmark && frameBenchmark->Done())) {
+        // a benchmark flying along a track ends with the track
+        if (frameBenchmark && playingTrack && !programState->cameraPlayer.Playing())
+            break;
+        RG_PROFILE_ZONE("Frame");
+        unsigned long long allocations = AllocationCounter::Allocations();
+        programState->FrameHeapAllocations = allocations - frameStartAllocations;
+        frameStartAllocations = allocations;
+        frameArena.Reset();
+        programState->FrameArenaBytes = frameArena.LastFrameBytes();
+        programState->FrameArenaCapacity = frameArena.Capacity();
+        if (frameBenchmark) {
+            frameBenchmark->BeginFrame();
+            offscreen->Bind();
+        }
+        gpuProfiler.BeginFrame();
+        textureStreamer.Update(programState->TextureUploadBudgetMs);
+
         // per-frame time logic
         // --------------------
         float currentFrame = glfwGetTime();
@@ -415,12 +692,25 @@ int main() {
 
         // input
         // -----
-        processInput(window);
+        {
+            RG_PROFILE_ZONE("Input");
+            processInput(window);
+
+            // a track being played overrides the input, and sets the frame's deltaTime
+            if (programState->cameraPlayer.Playing())
+                deltaTime = programState->cameraPlayer.Advance(programState->camera, deltaTime);
+            if (programState->RecordingCamera)
+                programState->cameraTrack.Add(programState->camera, deltaTime);
+        }
 
-        if(programState->AntiAliasing)
-            glEnable(GL_MULTISAMPLE);
-        else
-            glDisable(GL_MULTISAMPLE);
+        if(programState->grassBenchmark.Running())
+            programState->grassBenchmark.Apply(programState->GrassMode, programState->GrassFieldSize);
+        if(programState->GrassFieldSize != grassField.TuftsPerSide()) {
+            grassField.Build(programState->GrassFieldSize);
+            glState.Invalidate();
+        }
+
+        glState.SetCapability(GL_MULTISAMPLE, programState->AntiAliasing);
 
         // render
         // ------
@@ -430,126 +720,268 @@ int main() {
         //view/projection initializing
         glm::mat4 projection = glm::perspective(glm::radians(programState->camera.Zoom),(float) SCR_WIDTH / (float) SCR_HEIGHT, 0.1f, 100.0f);
         glm::mat4 view = programState->camera.GetViewMatrix();
+        Frustum frustum(projection * view);
+
+        // shared uniform blocks, only the parts that changed since last frame are uploaded
+        {
+            RG_PROFILE_ZONE("Uniforms");
+            CameraUniforms cameraUniforms;
+            cameraUniforms.projection = projection;
+            cameraUniforms.view = view;
+            cameraUniforms.viewPosition = programState->camera.Position;
+            cameraBuffer.Update(cameraUniforms);
+
+            LightUniforms lightUniforms;
+            lightUniforms.dirLight = dirLight;
+            lightUniforms.pointLight = pointLight;
+            lightUniforms.spotLight = spotLight;
+            lightBuffer.Update(lightUniforms);
+            programState->UniformUploadBytes = cameraBuffer.LastUploadBytes() + lightBuffer.LastUploadBytes();
+        }
 
         //setting shaders up
-        mainShader.use();
-        bindDirLight(mainShader, dirLight);
-        bindSpotLight(mainShader, spotLight);
-        bindPointLight(mainShader, pointLight);
-        bindCameraPosition(mainShader, programState->camera.Position);
-        bindShininess(mainShader, 32.0f);
-
-        grassShader.use();
-        bindDirLight(grassShader, dirLight);
-        bindSpotLight(grassShader, spotLight);
-        bindPointLight(grassShader, pointLight);
-        bindCameraPosition(grassShader, programState->camera.Position);
-        bindShininess(grassShader, 16.0f);
-
-
-        // view/projection settings
-        mainShader.use();
-        setShaderProjectionMatrix(mainShader, projection);
-        setShaderViewMatrix(mainShader, view);
-
-        grassShader.use();
-        setShaderProjectionMatrix(grassShader, projection);
-        setShaderViewMatrix(grassShader, view);
-
-        planeShader.use();
-        setShaderProjectionMatrix(planeShader, projection);
-        setShaderViewMatrix(planeShader, view);
-
-        // render loaded models
-
-        //goal
-        mainShader.use();
-        glCullFace(GL_BACK);
-        glm::mat4 model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(0.0f));
-        model = glm::scale(model, glm::vec3(0.01f));
-        model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1, 0, 0));
-        setShaderModelMatrix(mainShader, model);
-        goalModel.Draw(mainShader);
-
-        //projector
-        mainShader.use();
-        model = glm::mat4(1.0f);
-        model = glm::translate(model,glm::vec3(20.0f, 0.0f, 20.0f));
-        model = glm::rotate(model, glm::radians(45.0f), glm::vec3(0, 1, 0));
-        model = glm::scale(model, glm::vec3(1.5f));
-        setShaderModelMatrix(mainShader, model);
-        projectorModel.Draw(mainShader);
-
-        //plane
-        planeShader.use();
-        glCullFace(GL_FRONT);
-        glBindVertexArray(planeVAO);
-        glBindTexture(GL_TEXTURE_2D, planeTexture);
-        model = glm::mat4(1.0f);
-        model = glm::scale(model, glm::vec3(51.0f));
-        setShaderModelMatrix(planeShader, model);
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-
-        //grass
-        grassShader.use();
-        glDisable(GL_CULL_FACE);
-        glBindVertexArray(grassVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, grassTextureDiffuse);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, grassTextureSpecular);
-        for(auto i : grassPosition){
+        // the models' materials set their own shininess when they are bound
+        Shader& activeGrassShader = programState->GrassMode == GRASS_MODE_PER_QUAD ? grassShader : grassInstancedShader;
+        const ShaderLocations& activeGrassLocations = programState->GrassMode == GRASS_MODE_PER_QUAD ? grassLocations : grassInstancedLocations;
+        activeGrassShader.use();
+        bindShininess(activeGrassShader, activeGrassLocations, 16.0f);
+
+        skyboxShader.use();
+        glm::mat4 skyboxView = glm::mat4(glm::mat3(view)); // remove translation from the view matrix
+        skyboxShader.setMat4(skyboxLocations.view, skyboxView);
+        skyboxShader.setMat4(skyboxLocations.projection, projection);
+
+        // the grass draws itself when the queue executes, so the closure has to outlive the submit block
+        auto drawGrass = [&]() {
+            RG_PROFILE_ZONE("Grass");
+            double grassStart = glfwGetTime();
+            grassField.CullingEnabled = programState->GrassCulling;
+            grassField.LodEnabled = programState->GrassLod;
+            if(programState->GrassMode == GRASS_MODE_GPU_CULLED) {
+                grassCuller.Cull(grassField, frustum, programState->camera.Position);
+                activeGrassShader.use();
+                grassCuller.Draw(grassField);
+            } else if(programState->GrassMode == GRASS_MODE_CPU_CULLED) {
+                grassField.Draw(frustum, programState->camera.Position);
+            } else {
+                // reference path: one draw call per quad, the transforms are built on the workers
+                // a batch of tufts at a time and drawn here
+                const std::vector<glm::vec3>& positions = grassField.Positions();
+                const size_t batch = 16384;
+                glState.BindVertexArray(grassVAO);
+                for (size_t base = 0; base < positions.size(); base += batch) {
+                    size_t count = std::min(batch, positions.size() - base);
+                    grassQuadTransforms.resize(count * 3);
+                    jobs.ParallelFor(0, count, 1024, [&](size_t first, size_t last) {
+                        for (size_t i = first; i < last; i++) {
+                            glm::mat4 quad = glm::translate(glm::mat4(1.0f), positions[base + i]);
+                            for (int j = 0; j < 3; j++) {
+                                quad = glm::rotate(quad, glm::radians(120.0f), glm::vec3(0, 1, 0));
+                                quad = glm::scale(quad, glm::vec3(1.6f, 1.0f, 1.6f));
+                                grassQuadTransforms[i * 3 + j] = quad;
+                            }
+                        }
+                    });
+                    for (const glm::mat4& quad : grassQuadTransforms) {
+                        setShaderModelMatrix(grassShader, grassLocations, quad);
+                        glDrawArrays(GL_TRIANGLES, 0, 6);
+                    }
+                }
+            }
+            programState->GrassCpuTime = (glfwGetTime() - grassStart) * 1000.0f;
+        };
+
+        {
+            RG_PROFILE_ZONE("Submit");
+            // everything is submitted to the render queue, which orders the draws by state
+            renderQueue.CullingEnabled = programState->MeshCulling;
+            renderQueue.Begin(frustum, programState->camera.Position, 100.0f);
+
+            //goal
+            renderQueue.SetProfileSection(modelsSection);
+            glm::mat4 model = glm::mat4(1.0f);
+            model = glm::translate(model,glm::vec3(0.0f));
+            model = glm::scale(model, glm::vec3(0.01f));
+            model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(1, 0, 0));
+            goalModel->Submit(renderQueue, RENDER_PASS_OPAQUE, mainShader, model, mainLocations.model);
+
+            //projector
             model = glm::mat4(1.0f);
-            model = glm::translate(model, i);
-            for(int j = 0;j < 3;j++) {
-                model = glm::rotate(model, glm::radians(120.0f), glm::vec3(0, 1, 0));
-                model = glm::scale(model, glm::vec3(1.6f, 1.0f, 1.6f));
-                setShaderModelMatrix(grassShader, model);
-                glDrawArrays(GL_TRIANGLES, 0, 6);
+            model = glm::translate(model,glm::vec3(20.0f, 0.0f, 20.0f));
+            model = glm::rotate(model, glm::radians(45.0f), glm::vec3(0, 1, 0));
+            model = glm::scale(model, glm::vec3(1.5f));
+            projectorModel->Submit(renderQueue, RENDER_PASS_OPAQUE, mainShader, model, mainLocations.model);
+
+            //plane
+            renderQueue.SetProfileSection(planeSection);
+            DrawItem plane;
+            plane.shader = &planeShader;
+            plane.model = glm::scale(glm::mat4(1.0f), glm::vec3(51.0f));
+            plane.modelLocation = planeLocations.model;
+            plane.vao = planeVAO;
+            plane.cullFace = GL_FRONT;
+            plane.textureCount = 1;
+            plane.textures[0] = planeTexture->id;
+            plane.count = 6;
+            renderQueue.Submit(RENDER_PASS_OPAQUE, std::move(plane));
+
+            //grass, the field issues its own draws
+            renderQueue.SetProfileSection(grassSection);
+            DrawItem grass;
+            grass.shader = &activeGrassShader;
+            grass.cullFace = GL_NONE;
+            grass.textureCount = 2;
+            grass.textures[0] = grassTextureDiffuse->id;
+            grass.textures[1] = grassTextureSpecular->id;
+            grass.command = DRAW_CUSTOM;
+            // a single reference fits std::function's inline storage, the whole closure would not
+            grass.custom = [&drawGrass]() { drawGrass(); };
+            renderQueue.Submit(RENDER_PASS_FOLIAGE, std::move(grass));
+
+            // skybox, depth test passes when values are equal to depth buffer's content
+            renderQueue.SetProfileSection(skyboxSection);
+            DrawItem skybox;
+            skybox.shader = &skyboxShader;
+            skybox.vao = skyboxVAO;
+            skybox.depthFunc = GL_LEQUAL;
+            skybox.textureTarget = GL_TEXTURE_CUBE_MAP;
+            skybox.textureCount = 1;
+            skybox.textures[0] = cubemapTexture->id;
+            skybox.count = 36;
+            renderQueue.Submit(RENDER_PASS_SKYBOX, std::move(skybox));
+        }
+
+        renderQueue.Execute();
+
+        // ImGui saves and restores the state it touches, so the tracker stays valid across it
+        glState.EndFrame();
+        jobs.EndFrame();
+        if (programState->ImGuiEnabled) {
+            RG_PROFILE_ZONE("ImGui");
+            gpuProfiler.Begin(imguiSection);
+            DrawImGui(programState, grassField, grassCuller, renderQueue, jobs, gpuProfiler, textureStreamer);
+            gpuProfiler.End();
+        }
+
+        if(programState->grassBenchmark.Running()) {
+            programState->grassBenchmark.Record(deltaTime * 1000.0f, programState->GrassCpuTime);
+            if(!programState->grassBenchmark.Running()) {
+                // the field goes back to the user's size on the next frame
+                programState->grassBenchmark.Restore(programState->GrassMode, programState->GrassFieldSize);
+                glfwSwapInterval(1);
             }
         }
 
-        // draw skybox
-        glDepthFunc(GL_LEQUAL);  // change depth function so depth test passes when values are equal to depth buffer's content
-        skyboxShader.use();
-        view = glm::mat4(glm::mat3(programState->camera.GetViewMatrix())); // remove translation from the view matrix
-        skyboxShader.setMat4("view", view);
-        skyboxShader.setMat4("projection", projection);
-        // skybox cube
-        glBindVertexArray(skyboxVAO);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapTexture);
-        glDrawArrays(GL_TRIANGLES, 0, 36);
-        glBindVertexArray(0);
-        glDepthFunc(GL_LESS);
-
-        glEnable(GL_CULL_FACE);
-
-        if (programState->ImGuiEnabled)
-            DrawImGui(programState);
+        if (frameBenchmark) {
+            frameBenchmark->EndFrame();
+            // nothing is presented, flushing keeps the driver from batching up whole frames
+            glFlush();
+            glfwPollEvents();
+            continue;
+        }
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
-        glfwSwapBuffers(window);
+        {
+            RG_PROFILE_ZONE("SwapBuffers");
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
     }
 
-    programState->SaveToFile("resources/program_state.txt");
+    if (frameBenchmark) {
+        const char* renderer = (const char*) glGetString(GL_RENDERER);
+        if (!commandLine.benchmarkOutPath.empty()) {
+            std::ofstream out(commandLine.benchmarkOutPath);
+            frameBenchmark->WriteJson(out, renderer, SCR_WIDTH, SCR_HEIGHT);
+            if (!out)
+                std::cerr << "Failed to write " << commandLine.benchmarkOutPath << std::endl;
+        } else {
+            std::ostream out(benchmarkOut);
+            frameBenchmark->WriteJson(out, renderer, SCR_WIDTH, SCR_HEIGHT);
+        }
+    } else
+        programState->SaveToFile("resources/program_state.txt");
+    if (programState->RecordingCamera)
+        programState->cameraTrack.Save(programState->CameraTrackPath);
+    if (!commandLine.tracePath.empty())
+        CpuProfiler::Get().WriteChromeTrace(commandLine.tracePath);
     delete programState;
-    ImGui_ImplOpenGL3_Shutdown();
-    ImGui_ImplGlfw_Shutdown();
-    ImGui::DestroyContext();
-    // glfw: terminate, clearing all previously allocated GLFW resources.
-    // ------------------------------------------------------------------
+    // the models own VAOs and buffers and hold the textures, release them before the streamer
+    goalModel.reset();
+    projectorModel.reset();
+    // programs and textures are deleted with their last handle
+    mainProgram.reset();
+    grassProgram.reset();
+    grassInstancedProgram.reset();
+    planeProgram.reset();
+    skyboxProgram.reset();
+    grassTextureDiffuse.reset();
+    grassTextureSpecular.reset();
+    planeTexture.reset();
+    cubemapTexture.reset();
+    // Shader does not delete its program, only the shared ones are deleted by their handles
+    glDeleteProgram(grassCullShader.ID);
     glDeleteVertexArrays(1, &grassVAO);
     glDeleteVertexArrays(1, &planeVAO);
     glDeleteBuffers(1, &grassVAO);
     glDeleteBuffers(1, &planeVAO);
-    glfwTerminate();
+    frameBenchmark.reset();
+    offscreen.reset();
+    // glfw: terminate, clearing all previously allocated GLFW resources, happens in contextTeardown
+    // once the remaining locals are destroyed
     return 0;
 }
 
+CommandLine parseCommandLine(int argc, char** argv) {
+    CommandLine commandLine;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--benchmark") == 0) {
+            commandLine.benchmark = true;
+            if (i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+                commandLine.benchmarkFrames = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--benchmark-out") == 0 && i + 1 < argc) {
+            commandLine.benchmarkOutPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--egl") == 0) {
+            commandLine.egl = true;
+        } else if (std::strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            commandLine.recordPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--play") == 0 && i + 1 < argc) {
+            commandLine.playPath = argv[++i];
+        } else if (std::strcmp(argv[i], "--playback") == 0 && i + 1 < argc) {
+            const char* mode = argv[++i];
+            commandLine.playbackMode = std::strcmp(mode, "fixed") == 0 ? PLAYBACK_FIXED_STEP
+                                       : std::strcmp(mode, "realtime") == 0 ? PLAYBACK_REAL_TIME
+                                       : PLAYBACK_RECORDED_FRAMES;
+        } else if (std::strcmp(argv[i], "--step") == 0 && i + 1 < argc) {
+            commandLine.playbackStep = std::max(0.0001f, (float) std::atof(argv[++i]));
+        } else if (std::strcmp(argv[i], "--obj-benchmark") == 0) {
+            commandLine.objBenchmarkIterations = 10;
+            if (i + 1 < argc && std::atoi(argv[i + 1]) > 0)
+                commandLine.objBenchmarkIterations = std::atoi(argv[++i]);
+        } else if (std::strcmp(argv[i], "--full-vertices") == 0) {
+            commandLine.packVertices = false;
+        } else if (std::strcmp(argv[i], "--keep-geometry") == 0) {
+            commandLine.keepGeometry = true;
+        } else if (std::strcmp(argv[i], "--merge-meshes") == 0) {
+            commandLine.mergeMeshes = true;
+        } else if (std::strcmp(argv[i], "--cook-textures") == 0) {
+            commandLine.cookTextures = true;
+        } else if (std::strcmp(argv[i], "--trace") == 0 && i + 1 < argc) {
+            commandLine.tracePath = argv[++i];
+        } else if (std::strcmp(argv[i], "--warmup") == 0 && i + 1 < argc) {
+            commandLine.warmupFrames = std::max(0, std::atoi(argv[++i]));
+        } else {
+            std::cerr << "Unknown argument " << argv[i] << ", usage: " << argv[0]
+                      << " [--benchmark [frames]] [--benchmark-out path] [--warmup frames] [--egl] [--record path] [--play path]"
+                         " [--playback frames|fixed|realtime] [--step seconds] [--trace path]"
+                         " [--obj-benchmark [iterations]] [--cook-textures] [--full-vertices] [--keep-geometry]"
+                         " [--merge-meshes]" << std::endl;
+        }
+    }
+    return commandLine;
+}
+
 void processInput(GLFWwindow *window) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
@@ -591,7 +1023,7 @@ void scroll_callback(GLFWwindow *window, double xoffset, double yoffset) {
     programState->camera.ProcessMouseScroll(yoffset);
 }
 
-void DrawImGui(ProgramState *programState) {
+void DrawImGui(ProgramState *programState, const GrassField& grassField, const GrassGpuCuller& grassCuller, const RenderQueue& renderQueue, const JobSystem& jobs, GpuProfiler& profiler, const TextureStreamer& textureStreamer) {
     ImGui_ImplOpenGL3_NewFrame();
     ImGui_ImplGlfw_NewFrame();
     ImGui::NewFrame();
@@ -611,6 +1043,189 @@ void DrawImGui(ProgramState *programState) {
         ImGui::Text("(Yaw, Pitch): (%f, %f)", c.Yaw, c.Pitch);
         ImGui::Text("Camera front: (%f, %f, %f)", c.Front.x, c.Front.y, c.Front.z);
         ImGui::Checkbox("Camera mouse update", &programState->CameraMouseMovementUpdateEnabled);
+
+        CameraTrack& track = programState->cameraTrack;
+        CameraPlayer& player = programState->cameraPlayer;
+        ImGui::Text("Camera track: %zu frames, %.2f s", track.Size(), track.Duration());
+        if (programState->RecordingCamera) {
+            if (ImGui::Button("Stop recording")) {
+                programState->RecordingCamera = false;
+                track.Save(programState->CameraTrackPath);
+            }
+        } else if (player.Playing()) {
+            ImGui::Text("Playing frame %zu", player.Frame());
+            if (ImGui::Button("Stop playback"))
+                player.Stop();
+        } else {
+            if (ImGui::Button("Record")) {
+                track.Clear();
+                programState->RecordingCamera = true;
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Load and play") && track.Load(programState->CameraTrackPath))
+                player.Start(&track, PLAYBACK_REAL_TIME);
+        }
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Renderer");
+        ImGui::Text("Draw items: %u", renderQueue.LastSize());
+        ImGui::Checkbox("Mesh frustum culling", &programState->MeshCulling);
+        const RenderQueueStats& queueStats = renderQueue.LastStats();
+        ImGui::Text("Meshes culled: %u of %u", queueStats.meshesCulled, queueStats.meshesTested);
+        ImGui::Text("Triangles culled: %llu", queueStats.trianglesCulled);
+        ImGui::Text("Material binds: %u, reused: %u", queueStats.materialBinds, queueStats.materialsReused);
+        ImGui::Text("Batch culling path: %s", CullPathName(DefaultCullPath()));
+        ImGui::Text("Heap allocations last frame: %llu", programState->FrameHeapAllocations);
+        ImGui::Text("Frame arena: %.1f of %.1f KB", programState->FrameArenaBytes / 1024.0, programState->FrameArenaCapacity / 1024.0);
+        const TextureStreamerStats& streamStats = textureStreamer.LastFrameStats();
+        ImGui::Text("Textures streaming: %u", textureStreamer.Pending());
+        ImGui::Text("Texture uploads: %u, %.1f KB in %.2f ms", streamStats.uploads, streamStats.bytes / 1024.0, streamStats.ms);
+        ImGui::DragFloat("Upload budget (ms)", &programState->TextureUploadBudgetMs, 0.1f, 0.1f, 16.0f);
+        if (ImGui::CollapsingHeader("Texture memory")) {
+            ImGui::Text("Immutable storage: %s", textureStreamer.ImmutableStorage() ? "yes" : "no");
+            unsigned long long uncompressed = 0, resident = 0;
+            if (ImGui::BeginTable("texture memory", 3, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+                ImGui::TableSetupColumn("Texture");
+                ImGui::TableSetupColumn("KB");
+                ImGui::TableSetupColumn("Saved KB");
+                ImGui::TableHeadersRow();
+                for (const TextureMemoryRecord& record : textureStreamer.MemoryRecords()) {
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    std::string::size_type slash = record.path.find_last_of('/');
+                    ImGui::Text("%s%s", record.path.c_str() + (slash == std::string::npos ? 0 : slash + 1), record.cooked ? " (cooked)" : "");
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%llu", record.gpuBytes / 1024);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%llu", (record.uncompressedBytes - std::min(record.uncompressedBytes, record.gpuBytes)) / 1024);
+                    uncompressed += record.uncompressedBytes;
+                    resident += record.gpuBytes;
+                }
+                ImGui::EndTable();
+            }
+            ImGui::Text("Total: %llu KB, %llu KB saved", resident / 1024, (uncompressed - std::min(uncompressed, resident)) / 1024);
+        }
+        if (ImGui::Button("Run batch culling benchmark"))
+            programState->CullingBenchmarkResults = RunCullingBenchmark();
+        for (const CullingBenchmarkResult& result : programState->CullingBenchmarkResults) {
+            if (result.supported)
+                ImGui::Text("%-6s %.3f ns/box, %u visible, %s", CullPathName(result.path), result.nsPerBox,
+                            result.visible, result.matchesScalar ? "matches scalar" : "MISMATCH");
+            else
+                ImGui::Text("%-6s not supported", CullPathName(result.path));
+        }
+        const GLStateStats& stateStats = GLState::Get().LastFrameStats();
+        ImGui::Text("GL state calls issued/filtered: %u/%u", stateStats.issued, stateStats.filtered);
+        ImGui::Text("Uniform buffer upload: %zu bytes", programState->UniformUploadBytes);
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Grass");
+        ImGuiIO& io = ImGui::GetIO();
+        ImGui::Text("Frame time: %.3f ms (%.1f FPS)", 1000.0f / io.Framerate, io.Framerate);
+        ImGui::Text("Grass CPU time: %.3f ms", programState->GrassCpuTime);
+        ImGui::RadioButton("Per quad", &programState->GrassMode, GRASS_MODE_PER_QUAD);
+        ImGui::SameLine();
+        ImGui::RadioButton("CPU culled", &programState->GrassMode, GRASS_MODE_CPU_CULLED);
+        ImGui::SameLine();
+        ImGui::RadioButton("GPU culled", &programState->GrassMode, GRASS_MODE_GPU_CULLED);
+        ImGui::Checkbox("Frustum culling", &programState->GrassCulling);
+        ImGui::Checkbox("Distance LOD", &programState->GrassLod);
+        ImGui::SliderInt("Tufts per side", &programState->GrassFieldSize, 10, 1000);
+        unsigned int tufts = grassField.TuftCount();
+        ImGui::Text("Tufts: %u in %zu chunks", tufts, grassField.Chunks().size());
+        if (programState->GrassMode == GRASS_MODE_GPU_CULLED) {
+            ImGui::Text("Visible tufts/crossed: %u/%u", grassCuller.VisibleCount(GRASS_LOD_TUFT),
+                        grassCuller.VisibleCount(GRASS_LOD_CROSS));
+        } else if (programState->GrassMode == GRASS_MODE_CPU_CULLED) {
+            const GrassStats& stats = grassField.Stats();
+            ImGui::Text("Chunks culled: %u", stats.chunksCulled);
+            ImGui::Text("Chunks tuft/cross/strip: %u/%u/%u", stats.chunksPerLod[GRASS_LOD_TUFT],
+                        stats.chunksPerLod[GRASS_LOD_CROSS], stats.chunksPerLod[GRASS_LOD_STRIP]);
+            ImGui::Text("Draw calls: %u", stats.drawCalls);
+            ImGui::Text("Vertices: %llu (unculled %llu)", stats.vertices,
+                        (unsigned long long) grassField.LodVertexCount(GRASS_LOD_TUFT) * tufts);
+        } else {
+            ImGui::Text("Draw calls: %u", 3 * tufts);
+        }
+
+        GrassBenchmark& benchmark = programState->grassBenchmark;
+        if (!benchmark.Running() && ImGui::Button("Run culling benchmark")) {
+            benchmark.Start(programState->GrassMode, programState->GrassFieldSize);
+            // measure the frames themselves, not the display refresh
+            glfwSwapInterval(0);
+        }
+        for (const GrassBenchmarkResult& result : benchmark.Results()) {
+            ImGui::Text("%s %7d tufts: frame %.2f ms, grass CPU %.3f ms",
+                        result.mode == GRASS_MODE_GPU_CULLED ? "GPU" : "CPU",
+                        result.tuftsPerSide * result.tuftsPerSide, result.frameMs, result.grassCpuMs);
+        }
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("Jobs");
+        const std::vector<JobWorkerStats>& workers = jobs.LastFrameStats();
+        for (size_t i = 0; i < workers.size(); i++) {
+            char label[64];
+            snprintf(label, sizeof(label), "%u jobs, %u stolen", workers[i].jobs, workers[i].steals);
+            ImGui::Text(i == 0 ? "main  " : "worker %zu", i);
+            ImGui::SameLine();
+            ImGui::ProgressBar(workers[i].utilization, ImVec2(-1.0f, 0.0f), label);
+        }
+        ImGui::End();
+    }
+
+    {
+        ImGui::Begin("GPU profiler");
+        ImGui::Checkbox("Enabled", &profiler.Enabled);
+        ImGui::SameLine();
+        if (ImGui::Button("Export CSV"))
+            profiler.ExportCsv("gpu_profile.csv");
+        ImGui::Text("Dropped frames: %u", profiler.DroppedFrames());
+        if (!profiler.StatisticsSupported())
+            ImGui::Text("ARB_pipeline_statistics_query not available");
+
+        int columns = profiler.StatisticsSupported() ? 5 : 2;
+        if (ImGui::BeginTable("sections", columns, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg)) {
+            ImGui::TableSetupColumn("Section");
+            ImGui::TableSetupColumn("GPU ms");
+            if (profiler.StatisticsSupported()) {
+                ImGui::TableSetupColumn("Vertices");
+                ImGui::TableSetupColumn("Primitives");
+                ImGui::TableSetupColumn("Fragments");
+            }
+            ImGui::TableHeadersRow();
+            for (int i = 0; i < profiler.SectionCount(); i++) {
+                const GpuSectionSample& sample = profiler.Latest(i);
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::Text("%s", profiler.SectionName(i).c_str());
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", sample.ms);
+                if (profiler.StatisticsSupported()) {
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%llu", (unsigned long long) sample.statistics[STAT_VERTEX_SHADER_INVOCATIONS]);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%llu", (unsigned long long) sample.statistics[STAT_PRIMITIVES_SUBMITTED]);
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%llu", (unsigned long long) sample.statistics[STAT_FRAGMENT_SHADER_INVOCATIONS]);
+                }
+            }
+            ImGui::EndTable();
+        }
+
+        for (int i = 0; i < profiler.SectionCount(); i++) {
+            const std::vector<float>& history = profiler.History(i);
+            char overlay[64];
+            snprintf(overlay, sizeof(overlay), "%s %.3f ms", profiler.SectionName(i).c_str(), history.back());
+            ImGui::PushID(i);
+            ImGui::PlotLines("", history.data(), (int) history.size(), 0, overlay, 0.0f, FLT_MAX, ImVec2(-1.0f, 40.0f));
+            ImGui::PopID();
+        }
         ImGui::End();
     }
 
@@ -628,73 +1243,33 @@ void key_callback(GLFWwindow *window, int key, int scancode, int action, int mod
             glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
         }
     }
-}
-
-unsigned int loadTexture(char const * path)
-{
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-
-    int width, height, nrComponents;
-    unsigned char *data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT); // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, format == GL_RGBA ? GL_CLAMP_TO_EDGE : GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-        stbi_image_free(data);
+    if (key == GLFW_KEY_F2 && action == GLFW_PRESS) {
+        if (!CpuProfiler::CompiledIn())
+            std::cout << "Built without RG_PROFILING, the trace is empty" << std::endl;
+        if (CpuProfiler::Get().WriteChromeTrace(programState->TracePath))
+            std::cout << "CPU trace written to " << programState->TracePath << std::endl;
     }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-
-    return textureID;
 }
 
-void bindPointLight(Shader &shader, PointLight pointLight){
-    shader.setVec3("pointLight.position", pointLight.position);
-    shader.setVec3("pointLight.ambient", pointLight.ambient);
-    shader.setVec3("pointLight.diffuse", pointLight.diffuse);
-    shader.setVec3("pointLight.specular", pointLight.specular);
-    shader.setFloat("pointLight.constant", pointLight.constant);
-    shader.setFloat("pointLight.linear", pointLight.linear);
-    shader.setFloat("pointLight.quadratic", pointLight.quadratic);
-}
-
-void bindCameraPosition(Shader &shader, glm::vec3 position){
-    shader.setVec3("viewPosition", position);
-}
-
-void bindShininess(Shader &shader, float value){
-    shader.setFloat("material.shininess", value);
+ResourceHandle<TextureResource> loadTexture(TextureStreamer &streamer, char const * path)
+{
+    StreamedTextureSettings settings;
+    // for this tutorial: use GL_CLAMP_TO_EDGE to prevent semi-transparent borders. Due to interpolation it takes texels from next repeat
+    settings.clampTransparent = true;
+    return ResourceManager::Get().LoadTexture(path, streamer, settings);
 }
 
-void setShaderViewMatrix(Shader &shader, glm::mat4 view){
-    shader.setMat4("view", view);
+void bindShininess(Shader &shader, const ShaderLocations &locations, float value){
+    shader.setFloat(locations.shininess, value);
 }
 
-void setShaderProjectionMatrix(Shader &shader, glm::mat4 projection){
-    shader.setMat4("projection", projection);
+void bindUniformBlocks(Shader &shader){
+    shader.bindUniformBlock("Camera", CAMERA_BLOCK_BINDING);
+    shader.bindUniformBlock("Lights", LIGHTS_BLOCK_BINDING);
 }
 
-void setShaderModelMatrix(Shader &shader, glm::mat4 model){
-    shader.setMat4("model", model);
+void setShaderModelMatrix(Shader &shader, const ShaderLocations &locations, const glm::mat4 &model){
+    shader.setMat4(locations.model, model);
 }
 
 void enableShaderDiffuseComponent(Shader &shader){
@@ -705,52 +1280,10 @@ void enableShaderSpecularComponent(Shader &shader){
     shader.setInt("material.texture_specular1", 1);
 }
 
-void bindSpotLight(Shader &shader, SpotLight spotLight){
-    shader.setVec3("spotLight.position", spotLight.position);
-    shader.setVec3("spotLight.direction", spotLight.direction);
-    shader.setFloat("spotLight.cutOff", spotLight.cutOff);
-    shader.setFloat("spotLight.outerCutOff", spotLight.outerCutOff);
-    shader.setVec3("spotLight.ambient", spotLight.ambient);
-    shader.setVec3("spotLight.diffuse", spotLight.diffuse);
-    shader.setVec3("spotLight.specular", spotLight.specular);
-    shader.setFloat("spotLight.constant", spotLight.constant);
-    shader.setFloat("spotLight.linear", spotLight.linear);
-    shader.setFloat("spotLight.quadratic", spotLight.quadratic);
-}
-
-void bindDirLight(Shader &shader, DirLight dirLight){
-    shader.setVec3("dirLight.direction", dirLight.direction);
-    shader.setVec3("dirLight.ambient", dirLight.ambient);
-    shader.setVec3("dirLight.diffuse", dirLight.diffuse);
-    shader.setVec3("dirLight.specular", dirLight.specular);
-}
-
-unsigned int loadCubemap(vector<std::string> faces)
+ResourceHandle<TextureResource> loadCubemap(TextureStreamer &streamer, vector<std::string> faces)
 {
-    unsigned int textureID;
-    glGenTextures(1, &textureID);
-    glBindTexture(GL_TEXTURE_CUBE_MAP, textureID);
-
-    int width, height, nrChannels;
-    for (unsigned int i = 0; i < faces.size(); i++)
-    {
-        unsigned char *data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-        if (data)
-        {
-            glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-            stbi_image_free(data);
-        }
-        else
-        {
-            std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            stbi_image_free(data);
-        }
-    }
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
-    return textureID;
+    StreamedTextureSettings settings;
+    settings.wrapS = settings.wrapT = GL_CLAMP_TO_EDGE;
+    settings.mipmaps = false;
+    return ResourceManager::Get().LoadCubemap(faces, streamer, settings);
 }
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <rg/BatchCuller.h>
+#include <rg/Frustum.h>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+// Every SIMD culling path the CPU runs has to return exactly the index list of the scalar one,
+// for box counts around the 4 and 8 box SIMD widths and for boxes touching the planes.
+
+static int failures = 0;
+
+static void checkPaths(const char* name, const Frustum& frustum, const BoundsSoA& bounds) {
+    std::vector<unsigned int> reference;
+    CullBounds(frustum, bounds, reference, CULL_PATH_SCALAR);
+    for (int path = CULL_PATH_SCALAR + 1; path < CULL_PATH_COUNT; path++) {
+        if (!CullPathSupported(path))
+            continue;
+        std::vector<unsigned int> visible;
+        CullBounds(frustum, bounds, visible, (CullPath) path);
+        if (visible != reference) {
+            std::printf("FAIL %s: %s returned %zu boxes, scalar %zu\n", name, CullPathName(path), visible.size(),
+                        reference.size());
+            failures++;
+        }
+    }
+}
+
+static BoundsSoA randomBoxes(std::mt19937& random, unsigned int count) {
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_real_distribution<float> size(0.0f, 4.0f);
+    BoundsSoA bounds;
+    for (unsigned int i = 0; i < count; i++) {
+        glm::vec3 min(position(random), position(random) * 0.2f, position(random));
+        bounds.Add(min, min + glm::vec3(size(random), size(random), size(random)));
+    }
+    return bounds;
+}
+
+int main() {
+    for (int path = CULL_PATH_SCALAR + 1; path < CULL_PATH_COUNT; path++)
+        std::printf("%s: %s\n", CullPathName(path), CullPathSupported(path) ? "tested" : "not supported, skipped");
+
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 100.0f);
+    glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 2.0f, 0.0f), glm::vec3(0.3f, 1.5f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    Frustum frustum(projection * view);
+
+    checkPaths("no boxes", frustum, BoundsSoA());
+
+    // tails of every length after the 4 and 8 box blocks
+    std::mt19937 random(1234);
+    char name[64];
+    for (unsigned int count = 1; count <= 33; count++) {
+        std::snprintf(name, sizeof(name), "%u random boxes", count);
+        checkPaths(name, frustum, randomBoxes(random, count));
+    }
+    checkPaths("100000 random boxes", frustum, randomBoxes(random, 100000));
+
+    // boxes whose faces lie on a plane or whose extents are zero
+    Frustum box(glm::mat4(1.0f));
+    BoundsSoA touching;
+    for (int x = -2; x <= 2; x++) {
+        for (int y = -2; y <= 2; y++) {
+            for (int z = -2; z <= 2; z++) {
+                glm::vec3 point(x * 0.5f, y * 0.5f, z * 0.5f);
+                touching.Add(point, point);
+                touching.Add(point, point + glm::vec3(0.5f));
+                touching.Add(point - glm::vec3(1.0f), point);
+            }
+        }
+    }
+    checkPaths("boxes on the planes of the unit cube", box, touching);
+
+    if (failures != 0) {
+        std::printf("%d failures\n", failures);
+        return 1;
+    }
+    std::printf("all culling paths match scalar\n");
+    return 0;
+}
@@ -0,0 +1,256 @@
+#include <glm/glm.hpp>
+#include <rg/VertexPacking.h>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+// Round trips of the half float and octahedral encodings and of PackVertices, checked against the
+// tolerances of VertexPackingOptions on the inputs most likely to break them.
+
+// what PackVertices reads, like Vertex in mesh.h without pulling in GL
+struct TestVertex {
+    glm::vec3 Position;
+    glm::vec3 Normal;
+    glm::vec2 TexCoords;
+    glm::vec3 Tangent;
+    glm::vec3 Bitangent;
+};
+
+static int failures = 0;
+
+static void check(bool condition, const char* what, double value = 0.0) {
+    if (!condition) {
+        std::printf("FAIL %s (%g)\n", what, value);
+        failures++;
+    }
+}
+
+static uint32_t bitsOf(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, 4);
+    return bits;
+}
+
+static void testHalf() {
+    using namespace vertexpacking;
+    // every finite half survives the trip through float unchanged
+    for (uint32_t half = 0; half <= 0xffffu; half++) {
+        if (((half >> 10) & 0x1fu) == 0x1fu)
+            continue;
+        if (floatToHalf(halfToFloat((uint16_t) half)) != half) {
+            check(false, "half -> float -> half", half);
+            break;
+        }
+    }
+    check(floatToHalf(0.0f) == 0x0000u, "+0 encodes to +0");
+    check(floatToHalf(-0.0f) == 0x8000u, "-0 keeps its sign");
+    check(bitsOf(halfToFloat(0x8000u)) == bitsOf(-0.0f), "-0 decodes to -0");
+    check(halfToFloat(0x0001u) == std::ldexp(1.0f, -24), "smallest subnormal");
+    check(halfToFloat(0x03ffu) == std::ldexp(1023.0f, -24), "largest subnormal");
+    check(floatToHalf(std::ldexp(1.0f, -26)) == 0x0000u, "below half a subnormal step rounds to 0");
+    check(floatToHalf(-std::ldexp(1.0f, -26)) == 0x8000u, "negative underflow keeps its sign");
+    check(floatToHalf(std::ldexp(3.0f, -26)) == 0x0001u, "three quarters of a step rounds up");
+    check(halfToFloat(floatToHalf(65504.0f)) == 65504.0f, "largest half");
+    check(floatToHalf(65520.0f) == 0x7c00u, "rounding past the largest half gives infinity");
+    check(floatToHalf(1e9f) == 0x7c00u, "large values overflow to infinity");
+
+    // normal halves are within half an ulp, 2^-11 relative
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> exponent(-14.0f, 15.0f);
+    float worst = 0.0f;
+    for (int i = 0; i < 100000; i++) {
+        float value = std::exp2(exponent(random)) * (i & 1 ? -1.0f : 1.0f);
+        worst = std::max(worst, std::abs(halfToFloat(floatToHalf(value)) - value) / std::abs(value));
+    }
+    check(worst <= std::ldexp(1.0f, -11), "normal half relative error", worst);
+}
+
+static float octError(const glm::vec3& vector) {
+    using namespace vertexpacking;
+    int16_t encoded[2];
+    octEncode(vector, encoded);
+    return glm::length(octDecode(encoded[0], encoded[1]) - vector);
+}
+
+static void testOctahedral(float tolerance) {
+    const glm::vec3 axes[] = {glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+                              glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)};
+    for (const glm::vec3& axis : axes)
+        check(octError(axis) <= 1e-6f, "axis aligned normal", octError(axis));
+    // around -Z the lower half folds over the edges of the square
+    const glm::vec3 folded[] = {glm::vec3(1e-4f, 0, -1), glm::vec3(-1e-4f, 1e-4f, -1), glm::vec3(1, 1, -1),
+                                glm::vec3(-1, 1, -1e-4f), glm::vec3(1, -1, 1e-4f), glm::vec3(0, -1, -1)};
+    for (const glm::vec3& vector : folded)
+        check(octError(glm::normalize(vector)) <= tolerance, "normal near -Z or the fold", octError(glm::normalize(vector)));
+
+    std::mt19937 random(11);
+    std::normal_distribution<float> gaussian;
+    float worst = 0.0f;
+    for (int i = 0; i < 100000; i++) {
+        glm::vec3 vector(gaussian(random), gaussian(random), gaussian(random));
+        if (glm::length(vector) > 1e-6f)
+            worst = std::max(worst, octError(glm::normalize(vector)));
+    }
+    check(worst <= tolerance, "random normals", worst);
+}
+
+// decodes vertex i the way mainShaderPacked.vs does
+static TestVertex decode(const PackedVertices& packed, size_t i) {
+    using namespace vertexpacking;
+    const VertexLayout& layout = packed.layout;
+    const unsigned char* in = packed.data.data() + i * layout.stride;
+    TestVertex vertex = {};
+    if (layout.quantizedPositions) {
+        int16_t position[3];
+        std::memcpy(position, in, 6);
+        vertex.Position = packed.positionOffset + packed.positionScale * glm::vec3(position[0], position[1], position[2]);
+    } else {
+        std::memcpy(&vertex.Position[0], in, 12);
+    }
+    int16_t normal[2];
+    std::memcpy(normal, in + layout.normalOffset, 4);
+    vertex.Normal = octDecode(normal[0], normal[1]);
+    if (layout.halfTexCoords) {
+        uint16_t texCoords[2];
+        std::memcpy(texCoords, in + layout.texCoordOffset, 4);
+        vertex.TexCoords = glm::vec2(halfToFloat(texCoords[0]), halfToFloat(texCoords[1]));
+    } else {
+        std::memcpy(&vertex.TexCoords[0], in + layout.texCoordOffset, 8);
+    }
+    if (layout.tangents) {
+        int16_t tangent[4];
+        std::memcpy(tangent, in + layout.tangentOffset, 8);
+        vertex.Tangent = octDecode(tangent[0], tangent[1]);
+        vertex.Bitangent = (tangent[2] / 32767.0f) * glm::cross(vertex.Normal, vertex.Tangent);
+    }
+    return vertex;
+}
+
+// packs the vertices and checks every decoded one against the source and the report
+static PackedVertices checkPacking(const char* name, const std::vector<TestVertex>& vertices, const VertexPackingOptions& options) {
+    glm::vec3 min(0.0f), max(0.0f);
+    if (!vertices.empty()) {
+        min = max = vertices[0].Position;
+        for (const TestVertex& vertex : vertices) {
+            min = glm::min(min, vertex.Position);
+            max = glm::max(max, vertex.Position);
+        }
+    }
+    glm::vec3 center = 0.5f * (min + max);
+    PackedVertices packed = PackVertices(vertices.data(), vertices.size(), center, options);
+    const VertexLayout& layout = packed.layout;
+    if (packed.data.size() != vertices.size() * layout.stride || layout.stride % 4 != 0) {
+        std::printf("FAIL %s: %zu bytes, stride %u\n", name, packed.data.size(), layout.stride);
+        failures++;
+        return packed;
+    }
+
+    float extent = 0.0f;
+    for (const TestVertex& vertex : vertices) {
+        glm::vec3 d = glm::abs(vertex.Position - center);
+        extent = std::max(extent, std::max(d.x, std::max(d.y, d.z)));
+    }
+    float positionError = 0.0f, normalError = 0.0f, texCoordError = 0.0f, tangentError = 0.0f;
+    bool bitangentSigns = true;
+    for (size_t i = 0; i < vertices.size(); i++) {
+        const TestVertex& source = vertices[i];
+        TestVertex decoded = decode(packed, i);
+        positionError = std::max(positionError, glm::length(decoded.Position - source.Position));
+        glm::vec3 normal = glm::length(source.Normal) > 0.0f ? glm::normalize(source.Normal) : glm::vec3(0.0f, 0.0f, 1.0f);
+        normalError = std::max(normalError, glm::length(decoded.Normal - normal));
+        for (int c = 0; c < 2; c++)
+            texCoordError = std::max(texCoordError, std::abs(decoded.TexCoords[c] - source.TexCoords[c]));
+        if (layout.tangents) {
+            tangentError = std::max(tangentError, glm::length(decoded.Tangent - glm::normalize(source.Tangent)));
+            bitangentSigns = bitangentSigns && glm::dot(decoded.Bitangent, source.Bitangent) > 0.0f;
+        }
+    }
+
+    char what[128];
+    std::snprintf(what, sizeof(what), "%s: position error", name);
+    check(positionError <= options.positionTolerance * std::max(extent, 1e-20f)
+          && positionError <= packed.report.positionError + 1e-6f * std::max(extent, 1.0f), what, positionError);
+    std::snprintf(what, sizeof(what), "%s: normal error", name);
+    check(normalError <= options.normalTolerance, what, normalError);
+    std::snprintf(what, sizeof(what), "%s: texCoord error", name);
+    check(texCoordError <= options.texCoordTolerance && texCoordError == packed.report.texCoordError, what, texCoordError);
+    std::snprintf(what, sizeof(what), "%s: tangent error", name);
+    check(tangentError <= options.normalTolerance && bitangentSigns, what, tangentError);
+    return packed;
+}
+
+static TestVertex vertex(const glm::vec3& position, const glm::vec3& normal, const glm::vec2& texCoords) {
+    glm::vec3 tangent = std::abs(normal.x) < 0.9f ? glm::cross(normal, glm::vec3(1, 0, 0)) : glm::cross(normal, glm::vec3(0, 1, 0));
+    if (glm::length(tangent) == 0.0f)
+        tangent = glm::vec3(1, 0, 0);
+    return TestVertex{position, normal, texCoords, tangent, glm::cross(normal, tangent)};
+}
+
+static void testPackVertices() {
+    VertexPackingOptions options;
+    options.enabled = true;
+
+    std::mt19937 random(3);
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+    std::vector<TestVertex> mesh;
+    for (int i = 0; i < 1000; i++) {
+        glm::vec3 normal = glm::normalize(glm::vec3(unit(random), unit(random), unit(random)) + glm::vec3(0, 0, 1e-3f));
+        mesh.push_back(vertex(glm::vec3(unit(random), unit(random), unit(random)) * 50.0f + glm::vec3(100, 0, -20),
+                              normal, glm::vec2(unit(random), unit(random)) * 0.5f + glm::vec2(0.5f)));
+    }
+    PackedVertices packed = checkPacking("random mesh", mesh, options);
+    check(packed.layout.quantizedPositions && packed.layout.halfTexCoords, "random mesh packs positions and uvs");
+
+    options.tangents = true;
+    checkPacking("random mesh with tangents", mesh, options);
+    options.tangents = false;
+
+    const glm::vec3 axes[] = {glm::vec3(1, 0, 0), glm::vec3(-1, 0, 0), glm::vec3(0, 1, 0),
+                              glm::vec3(0, -1, 0), glm::vec3(0, 0, 1), glm::vec3(0, 0, -1)};
+    std::vector<TestVertex> axisNormals;
+    for (int i = 0; i < 6; i++)
+        axisNormals.push_back(vertex(axes[i] * 2.0f, axes[i], glm::vec2(0.0f)));
+    axisNormals.push_back(vertex(glm::vec3(0.0f), glm::vec3(0, 0, -3), glm::vec2(-0.0f, 0.0f)));
+    options.tangents = true;
+    checkPacking("axis aligned and -Z normals", axisNormals, options);
+    options.tangents = false;
+
+    // subnormal halves stay within the tolerance, large UVs fall back to floats and come back exactly
+    std::vector<TestVertex> tinyUVs;
+    for (int i = 0; i < 16; i++)
+        tinyUVs.push_back(vertex(glm::vec3((float) i, 0, 0), glm::vec3(0, 1, 0), glm::vec2(std::ldexp(1.0f, -20 - i), -std::ldexp(3.0f, -24))));
+    packed = checkPacking("subnormal uvs", tinyUVs, options);
+    check(packed.layout.halfTexCoords, "subnormal uvs stay half");
+
+    std::vector<TestVertex> largeUVs = tinyUVs;
+    largeUVs[3].TexCoords = glm::vec2(1000.3f, -4096.7f);
+    packed = checkPacking("large uvs", largeUVs, options);
+    check(!packed.layout.halfTexCoords && packed.report.texCoordError == 0.0f, "large uvs fall back to floats");
+
+    // a point, a flat mesh and no vertices at all
+    std::vector<TestVertex> point(3, vertex(glm::vec3(5.0f, -7.0f, 1e6f), glm::vec3(0.0f), glm::vec2(0.25f)));
+    packed = checkPacking("zero extent mesh", point, options);
+    check(packed.positionScale == 1.0f, "zero extent mesh keeps scale 1", packed.positionScale);
+    std::vector<TestVertex> flat;
+    for (int i = 0; i < 8; i++)
+        flat.push_back(vertex(glm::vec3((float) i, 0.0f, 0.0f), glm::vec3(0, 0, -1), glm::vec2(0.0f)));
+    checkPacking("mesh flat along two axes", flat, options);
+    packed = checkPacking("empty mesh", std::vector<TestVertex>(), options);
+    check(packed.data.empty() && packed.report.bytes == 0, "empty mesh has no bytes");
+}
+
+int main() {
+    VertexPackingOptions options;
+    testHalf();
+    testOctahedral(options.normalTolerance);
+    testPackVertices();
+    if (failures != 0) {
+        std::printf("%d failures\n", failures);
+        return 1;
+    }
+    std::printf("vertex packing round trips within tolerance\n");
+    return 0;
+}